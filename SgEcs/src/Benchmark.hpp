@@ -0,0 +1,553 @@
+#pragma once
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include "Ecs.hpp"
+
+namespace sg
+{
+    namespace ecs
+    {
+        namespace bench
+        {
+            //-------------------------------------------------
+            // Define components && component list
+            //-------------------------------------------------
+
+            struct PositionComponent
+            {
+                float x{ 0 };
+                float y{ 0 };
+            };
+
+            struct VelocityComponent
+            {
+                float x{ 0 };
+                float y{ 0 };
+            };
+
+            using BenchComponentsList = ComponentList<PositionComponent, VelocityComponent>;
+
+            struct TransformComponent
+            {
+                float m[16]{ 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+            };
+
+            struct RotationComponent
+            {
+                float m[16]{ 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+            };
+
+            using MatrixComponentsList = ComponentList<TransformComponent, RotationComponent>;
+
+            //-------------------------------------------------
+            // Define signatures && signature list
+            //-------------------------------------------------
+
+            using SignatureMove = Signature<PositionComponent, Read<VelocityComponent>>;
+
+            using BenchSignaturesList = SignatureList<SignatureMove>;
+
+            using SignatureRotate = Signature<TransformComponent, Read<RotationComponent>>;
+
+            using MatrixSignaturesList = SignatureList<SignatureRotate>;
+
+            //-------------------------------------------------
+            // Create `Settings` && `Manager`
+            //-------------------------------------------------
+
+            using BenchSettings = Settings<BenchComponentsList, BenchSignaturesList>;
+            using BenchManager = Manager<BenchSettings>;
+
+            using MatrixSettings = Settings<MatrixComponentsList, MatrixSignaturesList>;
+            using MatrixManager = Manager<MatrixSettings>;
+
+            //-------------------------------------------------
+            // Helper
+            //-------------------------------------------------
+
+            /**
+             * @brief Measures the wall-clock time of a callable.
+             * @tparam TCallable A callable type.
+             * @param callable The function to measure.
+             * @return The elapsed time in milliseconds.
+             */
+            template <typename TCallable>
+            double MeasureMilliseconds(TCallable&& callable)
+            {
+                const auto start{ std::chrono::steady_clock::now() };
+                callable();
+                const auto end{ std::chrono::steady_clock::now() };
+
+                return std::chrono::duration<double, std::milli>(end - start).count();
+            }
+
+            /**
+             * @brief Runs one movement system over all entities.
+             * @param manager The manager to use.
+             */
+            inline void Move(BenchManager& manager)
+            {
+                manager.ForEntitiesMatching<SignatureMove>
+                (
+                    [](auto /*entityIndex*/, const VelocityComponent& velocityComponent, PositionComponent& positionComponent)
+                    {
+                        positionComponent.x += velocityComponent.x;
+                        positionComponent.y += velocityComponent.y;
+                    }
+                );
+            }
+
+            /**
+             * @brief Runs the movement system over contiguous chunks.
+             * @param manager The manager to use.
+             */
+            inline void MoveChunks(BenchManager& manager)
+            {
+                manager.ForEachChunk<SignatureMove>
+                (
+                    [](Span<const EntityIndex> entityIndices, Span<const VelocityComponent> velocityComponents, Span<PositionComponent> positionComponents)
+                    {
+                        for (std::size_t i{ 0 }; i < entityIndices.size(); ++i)
+                        {
+                            positionComponents[i].x += velocityComponents[i].x;
+                            positionComponents[i].y += velocityComponents[i].y;
+                        }
+                    }
+                );
+            }
+
+            /**
+             * @brief Runs the rotation system, a 4x4 matrix product per entity, over all entities.
+             * @param manager The manager to use.
+             */
+            inline void Rotate(MatrixManager& manager)
+            {
+                manager.ForEntitiesMatching<SignatureRotate>
+                (
+                    [](auto /*entityIndex*/, const RotationComponent& rotationComponent, TransformComponent& transformComponent)
+                    {
+                        TransformComponent result;
+
+                        for (auto row{ 0u }; row < 4; ++row)
+                        {
+                            for (auto column{ 0u }; column < 4; ++column)
+                            {
+                                auto sum{ 0.0f };
+                                for (auto k{ 0u }; k < 4; ++k)
+                                {
+                                    sum += rotationComponent.m[row * 4 + k] * transformComponent.m[k * 4 + column];
+                                }
+
+                                result.m[row * 4 + column] = sum;
+                            }
+                        }
+
+                        transformComponent = result;
+                    }
+                );
+            }
+
+            /**
+             * @brief Creates a world whose components are scattered by heavy churn.
+             *        Swap compaction moves entities from the back into the holes, so their components end up far apart.
+             * @tparam TManager The manager type.
+             * @tparam TComponents The component types of every entity.
+             * @param manager The manager to fill.
+             * @param entityCount The number of entities.
+             * @param components The components of every entity.
+             */
+            template <typename TManager, typename... TComponents>
+            void CreateFragmentedWorld(TManager& manager, const std::size_t entityCount, const TComponents&... components)
+            {
+                manager.CreateIndices(entityCount, components...);
+                manager.Refresh();
+
+                std::mt19937 random{ 42 };
+                for (auto round{ 0u }; round < 10; ++round)
+                {
+                    for (auto kill{ 0u }; kill < entityCount / 2; ++kill)
+                    {
+                        manager.Kill(random() % manager.GetEntityCount());
+                    }
+
+                    manager.Refresh();
+                    manager.CreateIndices(entityCount - manager.GetEntityCount(), components...);
+                    manager.Refresh();
+                }
+            }
+
+            /**
+             * @brief Creates a world of moving entities whose components are scattered by heavy churn.
+             * @param manager The manager to fill.
+             * @param entityCount The number of entities.
+             */
+            inline void CreateFragmentedWorld(BenchManager& manager, const std::size_t entityCount)
+            {
+                CreateFragmentedWorld(manager, entityCount, PositionComponent{}, VelocityComponent{ 1.0f, 1.0f });
+            }
+
+            //-------------------------------------------------
+            // Benchmarks
+            //-------------------------------------------------
+
+            /**
+             * @brief Kills and spawns 1% of the entities per frame and compares the refresh modes.
+             */
+            inline void BenchmarkRefreshModes()
+            {
+                static constexpr std::size_t ENTITY_COUNT{ 200000 };
+                static constexpr std::size_t FRAMES{ 100 };
+
+                std::cout << "Refresh modes (" << ENTITY_COUNT << " entities, " << FRAMES << " frames, 1% churn)\n";
+
+                for (const auto refreshMode : { RefreshMode::SwapCompact, RefreshMode::StableCompact })
+                {
+                    BenchManager manager;
+                    manager.SetRefreshMode(refreshMode);
+                    manager.CreateIndices(ENTITY_COUNT, PositionComponent{}, VelocityComponent{ 1.0f, 1.0f });
+                    manager.Refresh();
+
+                    std::mt19937 random{ 42 };
+                    auto refreshMilliseconds{ 0.0 };
+                    auto moveMilliseconds{ 0.0 };
+
+                    for (auto frame{ 0u }; frame < FRAMES; ++frame)
+                    {
+                        for (auto kill{ 0u }; kill < ENTITY_COUNT / 100; ++kill)
+                        {
+                            manager.Kill(random() % manager.GetEntityCount());
+                        }
+
+                        manager.CreateIndices(ENTITY_COUNT / 100, PositionComponent{}, VelocityComponent{ 1.0f, 1.0f });
+
+                        refreshMilliseconds += MeasureMilliseconds([&manager]() { manager.Refresh(); });
+                        moveMilliseconds += MeasureMilliseconds([&manager]() { Move(manager); });
+                    }
+
+                    std::cout << (refreshMode == RefreshMode::SwapCompact ? "  SwapCompact:   " : "  StableCompact: ")
+                        << "refresh " << refreshMilliseconds / FRAMES << " ms/frame, "
+                        << "move " << moveMilliseconds / FRAMES << " ms/frame\n";
+                }
+            }
+
+            /**
+             * @brief Compares per-entity callbacks with chunk callbacks on a freshly created and on a fragmented world.
+             */
+            inline void BenchmarkChunks()
+            {
+                static constexpr std::size_t ENTITY_COUNT{ 1000000 };
+                static constexpr std::size_t FRAMES{ 100 };
+
+                std::cout << "Move system (" << ENTITY_COUNT << " entities, " << FRAMES << " frames)\n";
+
+                BenchManager manager;
+                manager.CreateIndices(ENTITY_COUNT, PositionComponent{}, VelocityComponent{ 1.0f, 1.0f });
+                manager.Refresh();
+
+                auto entityMilliseconds{ 0.0 };
+                auto chunkMilliseconds{ 0.0 };
+
+                for (auto frame{ 0u }; frame < FRAMES; ++frame)
+                {
+                    entityMilliseconds += MeasureMilliseconds([&manager]() { Move(manager); });
+                    chunkMilliseconds += MeasureMilliseconds([&manager]() { MoveChunks(manager); });
+                }
+
+                std::cout << "  ForEntitiesMatching: " << entityMilliseconds / FRAMES << " ms/frame\n"
+                    << "  ForEachChunk:        " << chunkMilliseconds / FRAMES << " ms/frame\n";
+
+                // the chunks of a fragmented world are short, mostly a single entity
+                BenchManager fragmented;
+                CreateFragmentedWorld(fragmented, ENTITY_COUNT);
+
+                entityMilliseconds = 0.0;
+                chunkMilliseconds = 0.0;
+
+                for (auto frame{ 0u }; frame < FRAMES; ++frame)
+                {
+                    entityMilliseconds += MeasureMilliseconds([&fragmented]() { Move(fragmented); });
+                    chunkMilliseconds += MeasureMilliseconds([&fragmented]() { MoveChunks(fragmented); });
+                }
+
+                std::cout << "  fragmented (" << fragmented.GetFragmentation() << ")\n"
+                    << "  ForEntitiesMatching: " << entityMilliseconds / FRAMES << " ms/frame\n"
+                    << "  ForEachChunk:        " << chunkMilliseconds / FRAMES << " ms/frame\n";
+            }
+
+            /**
+             * @brief Scatters the components of a world larger than the cache with heavy churn
+             *        and compares prefetch distances for a system doing a matrix product per entity.
+             */
+            inline void BenchmarkPrefetch()
+            {
+                static constexpr std::size_t ENTITY_COUNT{ 6000000 };
+                static constexpr std::size_t FRAMES{ 5 };
+
+                MatrixManager manager;
+                CreateFragmentedWorld(manager, ENTITY_COUNT, TransformComponent{}, RotationComponent{});
+
+                std::cout << "Prefetch distance (" << ENTITY_COUNT << " entities, "
+                    << ENTITY_COUNT * (sizeof(TransformComponent) + sizeof(RotationComponent)) / (1024 * 1024) << " MiB of components, "
+                    << "fragmentation " << manager.GetFragmentation() << ")\n";
+
+                for (const auto scanMode : { ScanMode::PerEntity, ScanMode::Blocks })
+                {
+                    manager.SetScanMode(scanMode);
+
+                    for (const auto distance : { 0u, 4u, 8u, 16u, 32u })
+                    {
+                        manager.SetPrefetchDistance(distance);
+                        Rotate(manager);
+
+                        auto rotateMilliseconds{ 0.0 };
+                        for (auto frame{ 0u }; frame < FRAMES; ++frame)
+                        {
+                            rotateMilliseconds += MeasureMilliseconds([&manager]() { Rotate(manager); });
+                        }
+
+                        std::cout << (scanMode == ScanMode::PerEntity ? "  per entity" : "  blocks") << ", distance " << distance << ": "
+                            << rotateMilliseconds / FRAMES << " ms/frame\n";
+                    }
+                }
+            }
+
+            /**
+             * @brief Compares `ScanMode::PerEntity` with `ScanMode::Blocks` at several densities of randomly placed matches.
+             */
+            inline void BenchmarkScanModes()
+            {
+                static constexpr std::size_t ENTITY_COUNT{ 1000000 };
+                static constexpr std::size_t FRAMES{ 40 };
+
+                std::cout << "Scan modes (" << ENTITY_COUNT << " entities, " << FRAMES << " frames)\n";
+
+                for (const auto percent : { 100u, 75u, 50u, 25u, 15u })
+                {
+                    BenchManager manager;
+                    std::mt19937 random{ 42 };
+                    std::uniform_int_distribution<unsigned> roll{ 0, 99 };
+
+                    for (std::size_t i{ 0 }; i < ENTITY_COUNT; ++i)
+                    {
+                        const auto entityIndex{ manager.CreateIndex() };
+                        manager.AddComponent<PositionComponent>(entityIndex);
+
+                        if (roll(random) < percent)
+                        {
+                            manager.AddComponent<VelocityComponent>(entityIndex) = VelocityComponent{ 1.0f, 1.0f };
+                        }
+                    }
+                    manager.Refresh();
+
+                    std::cout << "  " << percent << "% matching:";
+
+                    for (const auto scanMode : { ScanMode::PerEntity, ScanMode::Blocks })
+                    {
+                        manager.SetScanMode(scanMode);
+                        Move(manager);
+
+                        auto moveMilliseconds{ 0.0 };
+                        for (auto frame{ 0u }; frame < FRAMES; ++frame)
+                        {
+                            moveMilliseconds += MeasureMilliseconds([&manager]() { Move(manager); });
+                        }
+
+                        std::cout << (scanMode == ScanMode::PerEntity ? " per entity " : ", blocks ") << moveMilliseconds / FRAMES << " ms/frame";
+                    }
+
+                    std::cout << "\n";
+                }
+            }
+
+            /**
+             * @brief Compares the signature iteration of a fragmented world with the iteration of an owning group.
+             */
+            inline void BenchmarkGroups()
+            {
+                static constexpr std::size_t ENTITY_COUNT{ 4000000 };
+                static constexpr std::size_t FRAMES{ 20 };
+
+                BenchManager manager;
+                CreateFragmentedWorld(manager, ENTITY_COUNT);
+
+                std::cout << "Owning group (" << ENTITY_COUNT << " entities, " << FRAMES << " frames)\n";
+
+                auto matchingMilliseconds{ 0.0 };
+                for (auto frame{ 0u }; frame < FRAMES; ++frame)
+                {
+                    matchingMilliseconds += MeasureMilliseconds([&manager]() { Move(manager); });
+                }
+
+                manager.AddGroup<SignatureMove>();
+
+                auto groupMilliseconds{ 0.0 };
+                for (auto frame{ 0u }; frame < FRAMES; ++frame)
+                {
+                    groupMilliseconds += MeasureMilliseconds([&manager]()
+                    {
+                        manager.ForEntitiesInGroup<SignatureMove>
+                        (
+                            [](auto /*entityIndex*/, const VelocityComponent& velocityComponent, PositionComponent& positionComponent)
+                            {
+                                positionComponent.x += velocityComponent.x;
+                                positionComponent.y += velocityComponent.y;
+                            }
+                        );
+                    });
+                }
+
+                std::cout << "  ForEntitiesMatching: " << matchingMilliseconds / FRAMES << " ms/frame\n"
+                    << "  ForEntitiesInGroup:  " << groupMilliseconds / FRAMES << " ms/frame\n";
+            }
+
+            /**
+             * @brief Compares five movement systems run one after another with one fused traversal.
+             */
+            inline void BenchmarkFused()
+            {
+                static constexpr std::size_t ENTITY_COUNT{ 1000000 };
+                static constexpr std::size_t FRAMES{ 20 };
+
+                BenchManager manager;
+                CreateFragmentedWorld(manager, ENTITY_COUNT);
+
+                std::cout << "Five systems (" << ENTITY_COUNT << " fragmented entities, " << FRAMES << " frames)\n";
+
+                const auto move = [](auto /*entityIndex*/, const VelocityComponent& velocityComponent, PositionComponent& positionComponent)
+                {
+                    positionComponent.x += velocityComponent.x;
+                    positionComponent.y += velocityComponent.y;
+                };
+
+                auto separateMilliseconds{ 0.0 };
+                auto fusedMilliseconds{ 0.0 };
+
+                for (auto frame{ 0u }; frame < FRAMES; ++frame)
+                {
+                    separateMilliseconds += MeasureMilliseconds([&manager, &move]()
+                    {
+                        for (auto system{ 0u }; system < 5; ++system)
+                        {
+                            manager.ForEntitiesMatching<SignatureMove>(move);
+                        }
+                    });
+
+                    fusedMilliseconds += MeasureMilliseconds([&manager, &move]()
+                    {
+                        manager.ForEntitiesMatchingFused<SignatureMove, SignatureMove, SignatureMove, SignatureMove, SignatureMove>(move, move, move, move, move);
+                    });
+                }
+
+                std::cout << "  separate: " << separateMilliseconds / FRAMES << " ms/frame\n"
+                    << "  fused:    " << fusedMilliseconds / FRAMES << " ms/frame\n";
+            }
+
+            /**
+             * @brief Moves entities every frame, updates a spatial grid and compares radius queries with a full scan.
+             */
+            inline void BenchmarkSpatialGrid()
+            {
+                static constexpr std::size_t ENTITY_COUNT{ 1000000 };
+                static constexpr std::size_t FRAMES{ 10 };
+                static constexpr std::size_t QUERIES{ 1000 };
+                static constexpr std::size_t SCAN_QUERIES{ 10 };
+                static constexpr float WORLD_SIZE{ 1000.0f };
+                static constexpr float RADIUS{ 5.0f };
+
+                std::cout << "Spatial grid (" << ENTITY_COUNT << " moving entities, " << FRAMES << " frames, radius " << RADIUS << ")\n";
+
+                BenchManager manager;
+                std::mt19937 random{ 42 };
+                std::uniform_real_distribution<float> position{ 0.0f, WORLD_SIZE };
+                std::uniform_real_distribution<float> velocity{ -1.0f, 1.0f };
+
+                for (std::size_t i{ 0 }; i < ENTITY_COUNT; ++i)
+                {
+                    const auto entityIndex{ manager.CreateIndex() };
+                    manager.AddComponent<PositionComponent>(entityIndex) = PositionComponent{ position(random), position(random) };
+                    manager.AddComponent<VelocityComponent>(entityIndex) = VelocityComponent{ velocity(random), velocity(random) };
+                }
+                manager.Refresh();
+
+                SpatialGrid<BenchSettings, PositionComponent> grid{ 2.0f * RADIUS, 1 << 18 };
+                const auto rebuildMilliseconds{ MeasureMilliseconds([&manager, &grid]() { grid.Update(manager); }) };
+
+                std::vector<EntityIndex> candidates;
+                auto updateMilliseconds{ 0.0 };
+                auto queryMilliseconds{ 0.0 };
+                auto scanMilliseconds{ 0.0 };
+                std::size_t found{ 0 };
+
+                for (auto frame{ 0u }; frame < FRAMES; ++frame)
+                {
+                    Move(manager);
+                    updateMilliseconds += MeasureMilliseconds([&manager, &grid]() { grid.Update(manager); });
+
+                    queryMilliseconds += MeasureMilliseconds([&]()
+                    {
+                        for (auto query{ 0u }; query < QUERIES; ++query)
+                        {
+                            grid.QueryRadius(position(random), position(random), RADIUS, candidates);
+                            found += candidates.size();
+                        }
+                    });
+
+                    scanMilliseconds += MeasureMilliseconds([&]()
+                    {
+                        const BenchManager& constManager{ manager };
+
+                        for (auto query{ 0u }; query < SCAN_QUERIES; ++query)
+                        {
+                            const auto x{ position(random) };
+                            const auto y{ position(random) };
+
+                            manager.ForEntities([&](auto entityIndex)
+                            {
+                                const auto& positionComponent{ constManager.GetComponent<PositionComponent>(entityIndex) };
+                                const auto dx{ positionComponent.x - x };
+                                const auto dy{ positionComponent.y - y };
+
+                                found += dx * dx + dy * dy <= RADIUS * RADIUS;
+                            });
+                        }
+                    });
+                }
+
+                // a spawned bullet and a spawned entity without a position touch only their own indices
+                auto spawnMilliseconds{ 0.0 };
+                for (auto frame{ 0u }; frame < FRAMES; ++frame)
+                {
+                    const auto bullet{ manager.CreateIndex() };
+                    manager.AddComponent<PositionComponent>(bullet) = PositionComponent{ position(random), position(random) };
+                    manager.AddComponent<VelocityComponent>(manager.CreateIndex());
+                    manager.Refresh();
+
+                    spawnMilliseconds += MeasureMilliseconds([&manager, &grid]() { grid.Update(manager); });
+                }
+
+                std::cout << "  rebuild:    " << rebuildMilliseconds << " ms\n"
+                    << "  update:     " << updateMilliseconds / FRAMES << " ms/frame (every position written)\n"
+                    << "  spawn:      " << spawnMilliseconds / FRAMES << " ms/frame (two entities spawned)\n"
+                    << "  grid query: " << queryMilliseconds / (FRAMES * QUERIES) * 1000.0 << " us/query\n"
+                    << "  full scan:  " << scanMilliseconds / (FRAMES * SCAN_QUERIES) * 1000.0 << " us/query"
+                    << " (" << found << " hits)\n";
+            }
+
+            /**
+             * @brief Runs all benchmarks.
+             */
+            inline void RunBenchmarks()
+            {
+                BenchmarkRefreshModes();
+                BenchmarkChunks();
+                BenchmarkPrefetch();
+                BenchmarkScanModes();
+                BenchmarkGroups();
+                BenchmarkFused();
+                BenchmarkSpatialGrid();
+            }
+        }
+    }
+}
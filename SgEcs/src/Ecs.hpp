@@ -15,8 +15,26 @@
 #include <boost/mpl/distance.hpp>
 #include <boost/mpl/contains.hpp>
 #include <boost/mpl/for_each.hpp>
+#include <algorithm>
+#include <array>
 #include <bitset>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
 #include <vector>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <xmmintrin.h>
+#define SG_ECS_PREFETCH(address) _mm_prefetch(reinterpret_cast<const char*>(address), _MM_HINT_T0)
+#else
+#define SG_ECS_PREFETCH(address) __builtin_prefetch(address)
+#endif
 #include "Util.hpp"
 
 namespace sg
@@ -29,6 +47,84 @@ namespace sg
 
         static constexpr std::size_t DEFAULT_ENTITY_CAPACITY{ 100 };
 
+        /**
+         * @brief Number of entities whose masks are matched at once before the callbacks run.
+         */
+        static constexpr std::size_t MATCH_BLOCK_SIZE{ 1024 };
+
+        /**
+         * @brief Number of `DataIndex` slots which share one maximum change version.
+         */
+        static constexpr std::size_t CHANGE_BLOCK_SIZE{ 64 };
+
+        /**
+         * @brief Number of entities marked by one task of `KillMatching()`.
+         */
+        static constexpr std::size_t KILL_TASK_SIZE{ 16 * MATCH_BLOCK_SIZE };
+
+        /**
+         * @brief `ForEntitiesMatching()` is driven by the population of the rarest required component
+         *        if fewer than one in `POPULATION_SCAN_FACTOR` entities has it.
+         */
+        static constexpr std::size_t POPULATION_SCAN_FACTOR{ 8 };
+
+        /**
+         * @brief Describes how killed entities are given back to the `Manager`.
+         */
+        enum class RefreshMode
+        {
+            /**
+             * @brief Killed entities stay in place until `Refresh()` swaps them to the right.
+             */
+            SwapCompact,
+
+            /**
+             * @brief Like `SwapCompact`, but `Refresh()` slides the alive entities to the left and
+             *        keeps their relative order.
+             */
+            StableCompact,
+
+            /**
+             * @brief `Refresh()` pushes the slots killed since the last `Refresh()` onto a free list and
+             *        `CreateIndex()` pops them again. `Refresh()` does not compact, so entity indices never move.
+             */
+            FreeList
+        };
+
+        /**
+         * @brief Describes how `Manager::SortBy()` orders the entities.
+         */
+        enum class SortMode
+        {
+            /**
+             * @brief A stable full sort in O(n log n).
+             */
+            Full,
+
+            /**
+             * @brief A stable insertion sort, which is fast for nearly sorted data, e.g. from frame to frame.
+             */
+            Insertion
+        };
+
+        /**
+         * @brief Describes how `Manager::ForEntitiesMatching()` finds the matches of a signature.
+         */
+        enum class ScanMode
+        {
+            /**
+             * @brief Every entity's mask is tested and the callable runs right away.
+             */
+            PerEntity,
+
+            /**
+             * @brief The masks of `MATCH_BLOCK_SIZE` entities are tested at once, with AVX2 or AVX-512 if enabled,
+             *        into a list of matches, then the callable runs over the list. Avoids mispredicted branches
+             *        when matching and non-matching entities are mixed, see `BenchmarkScanModes()`.
+             */
+            Blocks
+        };
+
         //-------------------------------------------------
         // Forward declaration
         //-------------------------------------------------
@@ -36,6 +132,9 @@ namespace sg
         template <typename TSettings>
         class SignatureBitsetsStorage;
 
+        template <typename TSettings>
+        class Manager;
+
         //-------------------------------------------------
         // Lists
         //-------------------------------------------------
@@ -64,6 +163,50 @@ namespace sg
         template <typename... TComponent>
         using Signature = boost::mpl::list<TComponent...>;
 
+        /**
+         * @brief A signature term: entities with one of these components do not match.
+         *        Example: `Signature<CircleComponent, Without<InputComponent>>`.
+         * @tparam TComponents The excluded component types.
+         */
+        template <typename... TComponents>
+        struct Without
+        {
+            using Components = boost::mpl::list<TComponents...>;
+        };
+
+        /**
+         * @brief A signature term: the components are passed to callbacks as pointers, which are
+         *        `nullptr` if the entity does not have them. They do not affect matching.
+         * @tparam TComponents The optional component types.
+         */
+        template <typename... TComponents>
+        struct Optional
+        {
+            using Components = boost::mpl::list<TComponents...>;
+        };
+
+        /**
+         * @brief A signature term: required components, which are passed to callbacks as const references.
+         *        Unlike plain components, reading them does not count as a change.
+         * @tparam TComponents The read-only component types.
+         */
+        template <typename... TComponents>
+        struct Read
+        {
+            using Components = boost::mpl::list<TComponents...>;
+        };
+
+        /**
+         * @brief Selects the entities whose component was written since a change version.
+         *        Example: `ForEntitiesMatching<SignatureVelocity, Changed<CircleComponent>>(sinceVersion, callable)`.
+         * @tparam TComponent The component type.
+         */
+        template <typename TComponent>
+        struct Changed
+        {
+            using Component = TComponent;
+        };
+
         /**
          * @brief List of all signature types.
          * @tparam TSignatures Signature types to list.
@@ -71,12 +214,20 @@ namespace sg
         template <typename... TSignatures>
         using SignatureList = boost::mpl::list<TSignatures...>;
 
+        /**
+         * @brief List of all relation types. A relation type is a tag, e.g. `struct ChildOf {};`.
+         * @tparam TRelations Relation types to list.
+         */
+        template <typename... TRelations>
+        using RelationList = boost::mpl::list<TRelations...>;
+
         //-------------------------------------------------
         // Entity
         //-------------------------------------------------
 
         using DataIndex = std::size_t;
         using EntityIndex = std::size_t;
+        using ChangeVersion = std::uint32_t;
 
         /**
          * @brief Entity metadata.
@@ -123,6 +274,44 @@ namespace sg
                         std::get<std::vector<decltype(componentType)>>(tupleOfComponentVectors).resize(newCapacity);
                     }
                 );
+
+                for (std::size_t componentId{ 0 }; componentId < Settings::ComponentCount(); ++componentId)
+                {
+                    m_versions[componentId].resize(newCapacity);
+                    m_blockVersions[componentId].resize((newCapacity + CHANGE_BLOCK_SIZE - 1) / CHANGE_BLOCK_SIZE);
+                    m_fullBlockVersions[componentId].resize((newCapacity + CHANGE_BLOCK_SIZE - 1) / CHANGE_BLOCK_SIZE);
+                }
+            }
+
+            /**
+             * @brief Swaps the components of two slots in every vector.
+             * @param lhs The first `DataIndex`.
+             * @param rhs The second `DataIndex`.
+             */
+            void SwapSlots(const DataIndex lhs, const DataIndex rhs)
+            {
+                boost::mpl::for_each<ComponentList>
+                (
+                    [&tupleOfComponentVectors = m_tupleOfComponentVectors, lhs, rhs](auto componentType)
+                    {
+                        auto& components{ std::get<std::vector<decltype(componentType)>>(tupleOfComponentVectors) };
+                        std::swap(components[lhs], components[rhs]);
+                    }
+                );
+
+                // the versions move with the components, the block maxima only grow
+                for (std::size_t componentId{ 0 }; componentId < Settings::ComponentCount(); ++componentId)
+                {
+                    SplitFullBlock(componentId, lhs / CHANGE_BLOCK_SIZE);
+                    SplitFullBlock(componentId, rhs / CHANGE_BLOCK_SIZE);
+
+                    auto& versions{ m_versions[componentId] };
+                    auto& blockVersions{ m_blockVersions[componentId] };
+
+                    std::swap(versions[lhs], versions[rhs]);
+                    blockVersions[lhs / CHANGE_BLOCK_SIZE] = std::max(blockVersions[lhs / CHANGE_BLOCK_SIZE], versions[lhs]);
+                    blockVersions[rhs / CHANGE_BLOCK_SIZE] = std::max(blockVersions[rhs / CHANGE_BLOCK_SIZE], versions[rhs]);
+                }
             }
 
             /**
@@ -137,11 +326,234 @@ namespace sg
                 return std::get<std::vector<TComponent>>(m_tupleOfComponentVectors)[dataIndex];
             }
 
+            /**
+             * @brief Get a component of a specific type via `DataIndex`.
+             * @tparam TComponent The component type.
+             * @param dataIndex The entity's `DataIndex`.
+             * @return Const reference to the component.
+             */
+            template <typename TComponent>
+            const auto& GetComponent(const DataIndex dataIndex) const noexcept
+            {
+                return std::get<std::vector<TComponent>>(m_tupleOfComponentVectors)[dataIndex];
+            }
+
+            /**
+             * @brief Get the vector of a specific component type.
+             * @tparam TComponent The component type.
+             * @return Reference to the vector.
+             */
+            template <typename TComponent>
+            auto& GetComponentVector() noexcept
+            {
+                return std::get<std::vector<TComponent>>(m_tupleOfComponentVectors);
+            }
+
+            /**
+             * @brief Assigns the same value to a contiguous range of components.
+             * @tparam TComponent The component type.
+             * @param first The first `DataIndex` of the range.
+             * @param count The number of components.
+             * @param value The value to copy.
+             */
+            template <typename TComponent>
+            void Fill(const DataIndex first, const std::size_t count, const TComponent& value)
+            {
+                auto& components{ std::get<std::vector<TComponent>>(m_tupleOfComponentVectors) };
+                std::fill_n(components.data() + first, count, value);
+
+                MarkChanged(Settings::template GetComponentId<TComponent>(), first, count);
+            }
+
+            /**
+             * @brief Stamps a component slot with the current change version.
+             * @param componentId The component Id.
+             * @param dataIndex The `DataIndex`.
+             */
+            void MarkChanged(const std::size_t componentId, const DataIndex dataIndex) noexcept
+            {
+                m_versions[componentId][dataIndex] = m_changeVersion;
+                m_blockVersions[componentId][dataIndex / CHANGE_BLOCK_SIZE] = m_changeVersion;
+            }
+
+            /**
+             * @brief Stamps a contiguous range of component slots with the current change version.
+             *        Blocks of `CHANGE_BLOCK_SIZE` slots inside the range are stamped as a whole,
+             *        only the slots at the ends of the range are stamped one by one.
+             * @param componentId The component Id.
+             * @param first The first `DataIndex` of the range.
+             * @param count The number of slots.
+             */
+            void MarkChanged(const std::size_t componentId, const DataIndex first, const std::size_t count) noexcept
+            {
+                // most runs of sparse matches are a single slot
+                if (count == 1)
+                {
+                    MarkChanged(componentId, first);
+                    return;
+                }
+
+                const auto version{ m_changeVersion };
+                auto* versions{ m_versions[componentId].data() };
+                auto* blockVersions{ m_blockVersions[componentId].data() };
+                auto* fullBlockVersions{ m_fullBlockVersions[componentId].data() };
+
+                const auto last{ first + count };
+                auto dataIndex{ first };
+
+                while (dataIndex < last)
+                {
+                    const auto block{ dataIndex / CHANGE_BLOCK_SIZE };
+                    const auto blockLast{ (block + 1) * CHANGE_BLOCK_SIZE };
+
+                    if (dataIndex % CHANGE_BLOCK_SIZE == 0 && blockLast <= last)
+                    {
+                        fullBlockVersions[block] = version;
+                        dataIndex = blockLast;
+                    }
+                    else
+                    {
+                        const auto end{ std::min(blockLast, last) };
+                        std::fill(versions + dataIndex, versions + end, version);
+                        dataIndex = end;
+                    }
+
+                    blockVersions[block] = version;
+                }
+            }
+
+            /**
+             * @brief Stamps a component slot of a specific type with the current change version.
+             * @tparam TComponent The component type.
+             * @param dataIndex The `DataIndex`.
+             */
+            template <typename TComponent>
+            void MarkChanged(const DataIndex dataIndex) noexcept
+            {
+                MarkChanged(Settings::template GetComponentId<TComponent>(), dataIndex);
+            }
+
+            /**
+             * @brief Get the change version of every slot of a component type. A slot was last written
+             *        at the maximum of its own version and the full block version of its block.
+             * @param componentId The component Id.
+             * @return Const reference to the versions.
+             */
+            const std::vector<ChangeVersion>& GetVersions(const std::size_t componentId) const noexcept
+            {
+                return m_versions[componentId];
+            }
+
+            /**
+             * @brief Get the maximum change version of every `CHANGE_BLOCK_SIZE` slots of a component type.
+             * @param componentId The component Id.
+             * @return Const reference to the versions.
+             */
+            const std::vector<ChangeVersion>& GetBlockVersions(const std::size_t componentId) const noexcept
+            {
+                return m_blockVersions[componentId];
+            }
+
+            /**
+             * @brief Get the version at which all `CHANGE_BLOCK_SIZE` slots of a block were last written at once.
+             * @param componentId The component Id.
+             * @return Const reference to the versions.
+             */
+            const std::vector<ChangeVersion>& GetFullBlockVersions(const std::size_t componentId) const noexcept
+            {
+                return m_fullBlockVersions[componentId];
+            }
+
+            /**
+             * @brief Returns the version which is stamped on written components.
+             * @return ChangeVersion
+             */
+            ChangeVersion GetChangeVersion() const noexcept
+            {
+                return m_changeVersion;
+            }
+
+            /**
+             * @brief Starts a new change version.
+             * @return The previous version.
+             */
+            ChangeVersion AdvanceChangeVersion() noexcept
+            {
+                return m_changeVersion++;
+            }
+
+            /**
+             * @brief Get the first component of a vector via component Id.
+             * @param componentId The component Id.
+             * @return Type-erased pointer to the first component.
+             */
+            void* GetColumnData(const std::size_t componentId) noexcept
+            {
+                assert(componentId < Settings::ComponentCount());
+
+                return GetColumnFunctions()[componentId](*this);
+            }
+
         protected:
 
         private:
             using Settings = TSettings;
             using ComponentList = typename Settings::ComponentList;
+            using ThisType = ComponentStorage<Settings>;
+
+            /**
+             * @brief Moves the full block version of a block into the versions of its slots,
+             *        before a single slot of the block gets a different history.
+             * @param componentId The component Id.
+             * @param block The block.
+             */
+            void SplitFullBlock(const std::size_t componentId, const std::size_t block) noexcept
+            {
+                auto& fullBlockVersion{ m_fullBlockVersions[componentId][block] };
+                if (fullBlockVersion == 0)
+                {
+                    return;
+                }
+
+                auto* versions{ m_versions[componentId].data() };
+                const auto last{ std::min((block + 1) * CHANGE_BLOCK_SIZE, m_versions[componentId].size()) };
+
+                for (auto dataIndex{ block * CHANGE_BLOCK_SIZE }; dataIndex < last; ++dataIndex)
+                {
+                    versions[dataIndex] = std::max(versions[dataIndex], fullBlockVersion);
+                }
+
+                fullBlockVersion = 0;
+            }
+
+            /**
+             * @brief Returns a table with a `data()` function for every component vector, indexed by the component Id.
+             * @return Const reference to the table.
+             */
+            static const auto& GetColumnFunctions()
+            {
+                static const auto table
+                {
+                    []()
+                    {
+                        std::array<void* (*)(ThisType&), Settings::ComponentCount()> functions{};
+
+                        boost::mpl::for_each<ComponentList>([&functions](auto componentType)
+                        {
+                            using Component = decltype(componentType);
+
+                            functions[Settings::template GetComponentId<Component>()] = [](ThisType& storage) -> void*
+                            {
+                                return storage.template GetComponentVector<Component>().data();
+                            };
+                        });
+
+                        return functions;
+                    }()
+                };
+
+                return table;
+            }
 
             /**
              * @brief "Unpack" the types from `ComponentList` in `TupleOfComponentVectors`.
@@ -149,6 +561,27 @@ namespace sg
             using TupleOfComponentVectors = typename TupleOfVectors<ComponentList>::type;
 
             TupleOfComponentVectors m_tupleOfComponentVectors;
+
+            /**
+             * @brief The change version of every slot, per component Id. `0` means never written.
+             */
+            std::array<std::vector<ChangeVersion>, Settings::ComponentCount()> m_versions;
+
+            /**
+             * @brief The maximum change version of every `CHANGE_BLOCK_SIZE` slots, per component Id.
+             */
+            std::array<std::vector<ChangeVersion>, Settings::ComponentCount()> m_blockVersions;
+
+            /**
+             * @brief The version at which all slots of a block were written by one range stamp, per component Id.
+             *        Saves writing the version of every slot when loops stamp whole runs.
+             */
+            std::array<std::vector<ChangeVersion>, Settings::ComponentCount()> m_fullBlockVersions;
+
+            /**
+             * @brief The version which is stamped on written components.
+             */
+            ChangeVersion m_changeVersion{ 1 };
         };
 
         //-------------------------------------------------
@@ -160,23 +593,31 @@ namespace sg
          * Example of usage
          * ----------------
          * using MySettings = sg::ecs::Settings<MyComponentsList, MySignaturesList>;
+         * using MySettingsWithRelations = sg::ecs::Settings<MyComponentsList, MySignaturesList, sg::ecs::RelationList<ChildOf>>;
          */
 
         /**
-         * @brief Settings class with the custom `ComponentList` and `SignatureList`.
+         * @brief Settings class with the custom `ComponentList`, `SignatureList` and optional `RelationList`.
          * @tparam TComponentList The `ComponentList`.
          * @tparam TSignatureList The `SignatureList`.
+         * @tparam TRelationList The `RelationList`.
          */
-        template <typename TComponentList, typename TSignatureList>
+        template <typename TComponentList, typename TSignatureList, typename TRelationList = RelationList<>>
         struct Settings
         {
             using ComponentList = TComponentList;
             using SignatureList = TSignatureList;
-            using ThisType = Settings<ComponentList, SignatureList>;
+            using RelationList = TRelationList;
+            using ThisType = Settings<ComponentList, SignatureList, RelationList>;
             using Bitset = std::bitset<boost::mpl::size<ComponentList>::value>;
             using TupleOfSignatureBitsets = typename TupleTypeRepeater<boost::mpl::size<SignatureList>::value, Bitset>::type;
             using SignatureBitsetsStorage = SignatureBitsetsStorage<ThisType>;
 
+            /**
+             * @brief A bitset stored as plain words, which can be matched with SIMD instructions.
+             */
+            using MaskWord = std::uint64_t;
+
             /**
              * @brief Determines the number of all component types.
              * @return std::size_t
@@ -186,6 +627,42 @@ namespace sg
                 return boost::mpl::size<ComponentList>();
             }
 
+            /**
+             * @brief Determines the number of `MaskWord` values needed for a bitset.
+             * @return std::size_t
+             */
+            static constexpr std::size_t MaskWordCount() noexcept
+            {
+                return ComponentCount() <= 64 ? 1 : (ComponentCount() + 63) / 64;
+            }
+
+            /**
+             * @brief Converts a bitset to `MaskWordCount()` words.
+             * @param bitset The bitset to convert.
+             * @param words The words to write.
+             */
+            static void ToMaskWords(const Bitset& bitset, MaskWord* words) noexcept
+            {
+                if (ComponentCount() <= 64)
+                {
+                    words[0] = bitset.to_ullong();
+                    return;
+                }
+
+                for (std::size_t word{ 0 }; word < MaskWordCount(); ++word)
+                {
+                    words[word] = 0;
+                }
+
+                for (std::size_t bit{ 0 }; bit < ComponentCount(); ++bit)
+                {
+                    if (bitset[bit])
+                    {
+                        words[bit / 64] |= MaskWord{ 1 } << (bit % 64);
+                    }
+                }
+            }
+
             /**
              * @brief Checks whether the passed component type is in the `ComponentList`.
              * @tparam TComponent The component type to be tested.
@@ -197,6 +674,27 @@ namespace sg
                 return boost::mpl::contains<ComponentList, TComponent>();
             }
 
+            /**
+             * @brief Checks whether all passed component types are in the `ComponentList`.
+             * @tparam TComponents The component types to be tested.
+             * @return bool
+             */
+            template <typename... TComponents>
+            static constexpr bool AreValidComponents() noexcept
+            {
+                const bool valid[]{ true, IsValidComponent<TComponents>()... };
+
+                for (const auto v : valid)
+                {
+                    if (!v)
+                    {
+                        return false;
+                    }
+                }
+
+                return true;
+            }
+
             /**
              * @brief Returns the Id of the component type.
              * @tparam TComponent The component type.
@@ -220,13 +718,40 @@ namespace sg
             }
 
             /**
-             * @brief Determines the number of all signature types.
+             * @brief Returns the size of a component type via component Id.
+             * @param componentId The component Id.
              * @return std::size_t
              */
-            static constexpr std::size_t SignatureCount() noexcept
+            static std::size_t GetComponentSize(const std::size_t componentId) noexcept
             {
-                return boost::mpl::size<SignatureList>();
-            }
+                static const auto sizes
+                {
+                    []()
+                    {
+                        std::array<std::size_t, ComponentCount()> result{};
+
+                        boost::mpl::for_each<ComponentList>([&result](auto componentType)
+                        {
+                            result[GetComponentId<decltype(componentType)>()] = sizeof(componentType);
+                        });
+
+                        return result;
+                    }()
+                };
+
+                assert(componentId < ComponentCount());
+
+                return sizes[componentId];
+            }
+
+            /**
+             * @brief Determines the number of all signature types.
+             * @return std::size_t
+             */
+            static constexpr std::size_t SignatureCount() noexcept
+            {
+                return boost::mpl::size<SignatureList>();
+            }
 
             /**
              * @brief Checks whether the passed signature type is in the `SignatureList`.
@@ -249,6 +774,37 @@ namespace sg
             {
                 return boost::mpl::distance<typename boost::mpl::begin<SignatureList>::type, typename boost::mpl::find<SignatureList, TSignature>::type>::value;
             }
+
+            /**
+             * @brief Determines the number of all relation types.
+             * @return std::size_t
+             */
+            static constexpr std::size_t RelationCount() noexcept
+            {
+                return boost::mpl::size<RelationList>();
+            }
+
+            /**
+             * @brief Checks whether the passed relation type is in the `RelationList`.
+             * @tparam TRelation The relation type to be tested.
+             * @return bool
+             */
+            template <typename TRelation>
+            static constexpr bool IsValidRelation() noexcept
+            {
+                return boost::mpl::contains<RelationList, TRelation>();
+            }
+
+            /**
+             * @brief Returns the Id of the relation type.
+             * @tparam TRelation The relation type.
+             * @return std::size_t
+             */
+            template <typename TRelation>
+            static constexpr std::size_t GetRelationId() noexcept
+            {
+                return boost::mpl::distance<typename boost::mpl::begin<RelationList>::type, typename boost::mpl::find<RelationList, TRelation>::type>::value;
+            }
         };
 
         //-------------------------------------------------
@@ -289,29 +845,106 @@ namespace sg
                 return std::get<Settings::template GetSignatureId<TSignature>()>(m_tupleOfSignatureBitsets);
             }
 
+            /**
+             * @brief Get the bitset of the `Without` terms.
+             * @tparam TSignature The signature type.
+             * @return Reference to the bitset.
+             */
+            template <typename TSignature>
+            auto& GetExcludedBitset() noexcept
+            {
+                static_assert(Settings::template IsValidSignature<TSignature>(), "");
+
+                return std::get<Settings::template GetSignatureId<TSignature>()>(m_tupleOfExcludedBitsets);
+            }
+
+            /**
+             * @brief Get the bitset of the `Without` terms.
+             * @tparam TSignature The signature type.
+             * @return Const reference to the bitset.
+             */
+            template <typename TSignature>
+            const auto& GetExcludedBitset() const noexcept
+            {
+                static_assert(Settings::template IsValidSignature<TSignature>(), "");
+
+                return std::get<Settings::template GetSignatureId<TSignature>()>(m_tupleOfExcludedBitsets);
+            }
+
         protected:
 
         private:
             using Settings = TSettings;
             using SignatureList = typename TSettings::SignatureList;
             using TupleOfSignatureBitsets = typename Settings::TupleOfSignatureBitsets;
+            using Bitset = typename Settings::Bitset;
 
             TupleOfSignatureBitsets m_tupleOfSignatureBitsets;
+            TupleOfSignatureBitsets m_tupleOfExcludedBitsets;
+
+            /**
+             * @brief Sets the bit of a required component.
+             * @tparam TComponent The component type.
+             */
+            template <typename TComponent>
+            static void SetTermBits(TComponent, Bitset& required, Bitset&) noexcept
+            {
+                static_assert(Settings::template IsValidComponent<TComponent>(), "");
+
+                required[Settings::template GetComponentBit<TComponent>()] = true;
+            }
+
+            /**
+             * @brief Sets the bits of excluded components.
+             * @tparam TComponents The component types.
+             */
+            template <typename... TComponents>
+            static void SetTermBits(Without<TComponents...>, Bitset&, Bitset& excluded) noexcept
+            {
+                static_assert(Settings::template AreValidComponents<TComponents...>(), "");
+
+                using Expand = int[];
+                (void)Expand{ 0, (excluded[Settings::template GetComponentBit<TComponents>()] = true, 0)... };
+            }
+
+            /**
+             * @brief Optional components do not affect matching.
+             * @tparam TComponents The component types.
+             */
+            template <typename... TComponents>
+            static void SetTermBits(Optional<TComponents...>, Bitset&, Bitset&) noexcept
+            {
+                static_assert(Settings::template AreValidComponents<TComponents...>(), "");
+            }
+
+            /**
+             * @brief Read-only components are required like plain components.
+             * @tparam TComponents The component types.
+             */
+            template <typename... TComponents>
+            static void SetTermBits(Read<TComponents...>, Bitset& required, Bitset&) noexcept
+            {
+                static_assert(Settings::template AreValidComponents<TComponents...>(), "");
+
+                using Expand = int[];
+                (void)Expand{ 0, (required[Settings::template GetComponentBit<TComponents>()] = true, 0)... };
+            }
 
             /**
-             * @brief Initializing the bitset for a single signature.
+             * @brief Initializing the bitsets for a single signature.
              * @tparam TSignature Th signature type.
              */
             template <typename TSignature>
             void InitSignatureBitset() noexcept
             {
                 auto& bitset{ GetSignatureBitset<TSignature>() };
+                auto& excludedBitset{ GetExcludedBitset<TSignature>() };
 
-                using SignatureComponents = TSignature;
+                using SignatureTerms = TSignature;
 
-                boost::mpl::for_each<SignatureComponents>([&bitset](auto componentType)
+                boost::mpl::for_each<SignatureTerms>([&bitset, &excludedBitset](auto term)
                 {
-                    bitset[Settings::template GetComponentBit<decltype(componentType)>()] = true;
+                    SetTermBits(term, bitset, excludedBitset);
                 });
             }
 
@@ -330,472 +963,4796 @@ namespace sg
         };
 
         //-------------------------------------------------
-        // Manager
+        // RelationStorage
         //-------------------------------------------------
 
-        /*
-         * ----------------
-         * Example of usage
-         * ----------------
-         * using MyManager = sg::ecs::Manager<MySettings>;
-         */
-
         /**
-         * @brief Managed all entities and components at runtime.
-         * @tparam TSettings The Ecs settings and wrapper for the `ComponentList` and `SignatureList`.
+         * @brief Stores relation pairs `source -> target` per relation type with a forward and a reverse index,
+         *        both keyed by entity index. Queries in both directions run in O(result).
+         * @tparam TSettings The Ecs settings and wrapper for the `ComponentList`, `SignatureList` and `RelationList`.
          */
         template <typename TSettings>
-        class Manager
+        class RelationStorage
         {
-        private:
-            using Settings = TSettings;
-            using ThisType = Manager<Settings>;
-            using ComponentStorage = ComponentStorage<Settings>;
-            using Bitset = typename Settings::Bitset;
-            using Entity = Entity<Settings>;
-            using SignatureBitsetsStorage = SignatureBitsetsStorage<Settings>;
-
+        public:
             /**
-             * @brief The entities are stored contiguously in a `std::vector`.
+             * @brief Grow the indexes.
+             * @param newCapacity
              */
-            std::vector<Entity> m_entities;
+            void GrowTo(const std::size_t newCapacity)
+            {
+                for (auto& relation : m_relations)
+                {
+                    relation.targets.resize(newCapacity);
+                    relation.sources.resize(newCapacity);
+                }
+            }
 
             /**
-             * @brief Size of allocated storage capacity for m_entities.
+             * @brief Adds a pair. Existing pairs are not added twice.
+             * @param relationId The relation Id.
+             * @param source The source entity index.
+             * @param target The target entity index.
              */
-            std::size_t m_capacity{ 0 };
+            void Add(const std::size_t relationId, const EntityIndex source, const EntityIndex target)
+            {
+                auto& relation{ m_relations[relationId] };
 
-            /**
-             * @brief Current size.
-             */
-            std::size_t m_size{ 0 };
+                if (Contains(relation.targets[source], target))
+                {
+                    return;
+                }
+
+                relation.targets[source].push_back(target);
+                relation.sources[target].push_back(source);
+            }
 
             /**
-             * @brief Next size.
+             * @brief Removes a pair.
+             * @param relationId The relation Id.
+             * @param source The source entity index.
+             * @param target The target entity index.
              */
-            std::size_t m_sizeNext{ 0 };
+            void Remove(const std::size_t relationId, const EntityIndex source, const EntityIndex target) noexcept
+            {
+                auto& relation{ m_relations[relationId] };
+
+                Erase(relation.targets[source], target);
+                Erase(relation.sources[target], source);
+            }
 
             /**
-             * @brief Wrapper of `TupleOfSignatureBitsets`.
+             * @brief Checks whether a pair exists.
+             * @param relationId The relation Id.
+             * @param source The source entity index.
+             * @param target The target entity index.
+             * @return bool
              */
-            SignatureBitsetsStorage m_signatureBitsetsStorage;
+            bool Has(const std::size_t relationId, const EntityIndex source, const EntityIndex target) const noexcept
+            {
+                return Contains(m_relations[relationId].targets[source], target);
+            }
 
             /**
-             * @brief Wrapper of `TupleOfComponentVectors`.
+             * @brief Returns the targets of a source.
+             * @param relationId The relation Id.
+             * @param source The source entity index.
+             * @return Span
              */
-            ComponentStorage m_componentStorage;
-
-        public:
-            Manager()
+            Span<const EntityIndex> GetTargets(const std::size_t relationId, const EntityIndex source) const noexcept
             {
-                GrowTo(DEFAULT_ENTITY_CAPACITY);
+                return m_relations[relationId].targets[source];
             }
 
             /**
-             * @brief Checks if the entity is alive.
-             * @param entityIndex The entity index.
-             * @return auto
+             * @brief Returns the sources of a target.
+             * @param relationId The relation Id.
+             * @param target The target entity index.
+             * @return Span
              */
-            auto IsAlive(const EntityIndex entityIndex) const noexcept
+            Span<const EntityIndex> GetSources(const std::size_t relationId, const EntityIndex target) const noexcept
             {
-                return GetEntity(entityIndex).alive;
+                return m_relations[relationId].sources[target];
             }
 
             /**
-             * @brief Kills an entity.
+             * @brief Removes all pairs of an entity in both directions.
              * @param entityIndex The entity index.
              */
-            void Kill(const EntityIndex entityIndex) noexcept
+            void RemoveAll(const EntityIndex entityIndex) noexcept
             {
-                GetEntity(entityIndex).alive = false;
+                for (auto& relation : m_relations)
+                {
+                    for (const auto target : relation.targets[entityIndex])
+                    {
+                        Erase(relation.sources[target], entityIndex);
+                    }
+
+                    for (const auto source : relation.sources[entityIndex])
+                    {
+                        Erase(relation.targets[source], entityIndex);
+                    }
+
+                    relation.targets[entityIndex].clear();
+                    relation.sources[entityIndex].clear();
+                }
             }
 
             /**
-             * @brief Creates a new entity.
-             * @return std::size_t
+             * @brief Follows two entities which swap their indices.
+             * @param lhs The first entity index.
+             * @param rhs The second entity index.
              */
-            auto CreateIndex()
+            void SwapEntities(const EntityIndex lhs, const EntityIndex rhs) noexcept
             {
-                GrowIfNeeded();
+                const auto swapped = [lhs, rhs](const EntityIndex value)
+                {
+                    return value == lhs ? rhs : value == rhs ? lhs : value;
+                };
 
-                const auto freeIndex{ m_sizeNext++ };
-                assert(!IsAlive(freeIndex));
+                for (auto& relation : m_relations)
+                {
+                    auto& targets{ relation.targets };
+                    auto& sources{ relation.sources };
 
-                // the new created entity is alive
-                auto& entity{ m_entities[freeIndex] };
-                entity.alive = true;
-                entity.bitset.reset();
+                    if (targets[lhs].empty() && targets[rhs].empty() && sources[lhs].empty() && sources[rhs].empty())
+                    {
+                        continue;
+                    }
 
-                return freeIndex;
+                    // detach the four rows, so that no list is renamed while it is iterated
+                    auto lhsTargets{ std::move(targets[lhs]) };
+                    auto rhsTargets{ std::move(targets[rhs]) };
+                    auto lhsSources{ std::move(sources[lhs]) };
+                    auto rhsSources{ std::move(sources[rhs]) };
+
+                    const auto targetsOf = [&](const EntityIndex index) -> std::vector<EntityIndex>&
+                    {
+                        return index == lhs ? lhsTargets : index == rhs ? rhsTargets : targets[index];
+                    };
+
+                    const auto sourcesOf = [&](const EntityIndex index) -> std::vector<EntityIndex>&
+                    {
+                        return index == lhs ? lhsSources : index == rhs ? rhsSources : sources[index];
+                    };
+
+                    for (const auto target : lhsTargets)
+                    {
+                        Rename(sourcesOf(target), lhs, rhs);
+                    }
+
+                    for (const auto target : rhsTargets)
+                    {
+                        if (!Contains(lhsTargets, target))
+                        {
+                            Rename(sourcesOf(target), lhs, rhs);
+                        }
+                    }
+
+                    // the detached source rows may already be renamed, `swapped()` gives back the old values
+                    for (const auto source : lhsSources)
+                    {
+                        Rename(targetsOf(swapped(source)), lhs, rhs);
+                    }
+
+                    for (const auto source : rhsSources)
+                    {
+                        if (!Contains(lhsSources, source))
+                        {
+                            Rename(targetsOf(swapped(source)), lhs, rhs);
+                        }
+                    }
+
+                    targets[lhs] = std::move(rhsTargets);
+                    targets[rhs] = std::move(lhsTargets);
+                    sources[lhs] = std::move(rhsSources);
+                    sources[rhs] = std::move(lhsSources);
+                }
             }
 
             /**
-             * @brief Clear the manager.
+             * @brief Follows a permutation of the entity indices.
+             * @param newIndices The new index of every entity index in [0, newIndices.size()).
              */
-            void Clear() noexcept
+            void Remap(const std::vector<EntityIndex>& newIndices)
             {
-                for (auto i{ 0u }; i < m_capacity; ++i)
+                for (auto& relation : m_relations)
                 {
-                    auto& entity(m_entities[i]);
+                    for (auto* index : { &relation.targets, &relation.sources })
+                    {
+                        auto& lists{ *index };
+                        std::vector<std::vector<EntityIndex>> moved(newIndices.size());
 
-                    entity.dataIndex = i;
-                    entity.bitset.reset();
-                    entity.alive = false;
-                }
+                        for (EntityIndex entityIndex{ 0 }; entityIndex < newIndices.size(); ++entityIndex)
+                        {
+                            for (auto& other : lists[entityIndex])
+                            {
+                                other = newIndices[other];
+                            }
 
-                m_size = m_sizeNext = 0;
+                            moved[newIndices[entityIndex]] = std::move(lists[entityIndex]);
+                        }
+
+                        std::move(moved.begin(), moved.end(), lists.begin());
+                    }
+                }
             }
 
             /**
-             * @brief Rearranges entities.
+             * @brief Removes all pairs.
              */
-            void Refresh() noexcept
+            void Clear() noexcept
             {
-                // If no new entities have been created, set `m_size` to `0` and exit early.
-                if (m_sizeNext == 0)
+                for (auto& relation : m_relations)
                 {
-                    m_size = 0;
-                    return;
-                }
+                    for (auto& targets : relation.targets)
+                    {
+                        targets.clear();
+                    }
 
-                // Otherwise, get the new `m_size` by calling `ArrangeAliveEntitiesToLeft()`.
-                // After refreshing, `m_size` will equal `m_sizeNext`.
-                // The final value for these variables will be calculated
-                // by re-arranging entity metadata in the `m_entities` vector.
-                m_size = m_sizeNext = ArrangeAliveEntitiesToLeft();
+                    for (auto& sources : relation.sources)
+                    {
+                        sources.clear();
+                    }
+                }
             }
 
+        protected:
+
+        private:
+            using Settings = TSettings;
+
             /**
-             * @brief Adds a component.
-             * @tparam TComponent The component type.
-             * @tparam TArgs The component parameter pack.
-             * @param entityIndex The entity index.
-             * @param args The component parameter pack.
-             * @return Reference to the component.
+             * @brief The forward and reverse index of one relation type.
              */
-            template <typename TComponent, typename... TArgs>
-            auto& AddComponent(const EntityIndex entityIndex, TArgs&&... args) noexcept
+            struct Relation
             {
-                static_assert(Settings::template IsValidComponent<TComponent>(), "");
-
-                // update entity bitset
-                auto& entity{ GetEntity(entityIndex) };
-                entity.bitset[Settings::template GetComponentBit<TComponent>()] = true;
-
-                // get component for re-construct
-                auto& component{ m_componentStorage.template GetComponent<TComponent>(entity.dataIndex) };
+                std::vector<std::vector<EntityIndex>> targets;
+                std::vector<std::vector<EntityIndex>> sources;
+            };
 
-                // placement new (construct an object on memory that's already allocated)
-                new (&component) TComponent(std::forward<decltype(args)>(args)...);
+            std::array<Relation, Settings::RelationCount()> m_relations;
 
-                return component;
+            static bool Contains(const std::vector<EntityIndex>& list, const EntityIndex value) noexcept
+            {
+                return std::find(list.cbegin(), list.cend(), value) != list.cend();
             }
 
-            /**
-             * @brief Checks if an entity is associated with a specific component type.
-             * @tparam TComponent The component type.
-             * @param entityIndex The entity index.
-             * @return bool
-             */
-            template <typename TComponent>
-            bool HasComponent(const EntityIndex entityIndex) const noexcept
+            static void Erase(std::vector<EntityIndex>& list, const EntityIndex value) noexcept
             {
-                static_assert(Settings::template IsValidComponent<TComponent>(), "");
-
-                return GetEntity(entityIndex).bitset[Settings::template GetComponentBit<TComponent>()];
+                const auto it{ std::find(list.begin(), list.end(), value) };
+                if (it != list.end())
+                {
+                    *it = list.back();
+                    list.pop_back();
+                }
             }
 
-            /**
-             * @brief Clears the association between the entity and the component type.
+            static void Rename(std::vector<EntityIndex>& list, const EntityIndex lhs, const EntityIndex rhs) noexcept
+            {
+                for (auto& value : list)
+                {
+                    value = value == lhs ? rhs : value == rhs ? lhs : value;
+                }
+            }
+        };
+
+        //-------------------------------------------------
+        // Prefab
+        //-------------------------------------------------
+
+        /*
+         * ----------------
+         * Example of usage
+         * ----------------
+         * sg::ecs::Prefab<MySettings> bullet;
+         * bullet.Set<HealthComponent>().health = 1;
+         * bullet.Set<CircleComponent>().radius = 2.0f;
+         * const auto first{ manager.Instantiate(bullet, 1000) };
+         */
+
+        /**
+         * @brief A component mask with prototype values, which can be instantiated many times.
+         * @tparam TSettings The Ecs settings and wrapper for the `ComponentList` and `SignatureList`.
+         */
+        template <typename TSettings>
+        class Prefab
+        {
+        private:
+            using Settings = TSettings;
+            using Bitset = typename Settings::Bitset;
+
+            /**
+             * @brief A `std::tuple` with one value for every component type.
+             */
+            using TupleOfComponents = typename Rename<typename Settings::ComponentList, std::tuple>::type;
+
+            Bitset m_bitset;
+            TupleOfComponents m_components;
+
+        public:
+            /**
+             * @brief Adds a component to the prefab.
+             * @tparam TComponent The component type.
+             * @tparam TArgs The component parameter pack.
+             * @param args The component parameter pack.
+             * @return Reference to the prototype value.
+             */
+            template <typename TComponent, typename... TArgs>
+            auto& Set(TArgs&&... args)
+            {
+                static_assert(Settings::template IsValidComponent<TComponent>(), "");
+
+                m_bitset[Settings::template GetComponentBit<TComponent>()] = true;
+
+                auto& component{ std::get<TComponent>(m_components) };
+                component = TComponent(std::forward<decltype(args)>(args)...);
+
+                return component;
+            }
+
+            /**
+             * @brief Removes a component from the prefab.
+             * @tparam TComponent The component type.
+             */
+            template <typename TComponent>
+            void Remove() noexcept
+            {
+                static_assert(Settings::template IsValidComponent<TComponent>(), "");
+
+                m_bitset[Settings::template GetComponentBit<TComponent>()] = false;
+            }
+
+            /**
+             * @brief Checks if the prefab contains a component type.
+             * @tparam TComponent The component type.
+             * @return bool
+             */
+            template <typename TComponent>
+            bool Has() const noexcept
+            {
+                static_assert(Settings::template IsValidComponent<TComponent>(), "");
+
+                return m_bitset[Settings::template GetComponentBit<TComponent>()];
+            }
+
+            /**
+             * @brief Returns the prototype value of a component.
+             * @tparam TComponent The component type.
+             * @return Const reference to the prototype value.
+             */
+            template <typename TComponent>
+            const auto& Get() const noexcept
+            {
+                assert(Has<TComponent>());
+
+                return std::get<TComponent>(m_components);
+            }
+
+            /**
+             * @brief Returns the component mask.
+             * @return Const reference to the bitset.
+             */
+            const Bitset& GetBitset() const noexcept
+            {
+                return m_bitset;
+            }
+        };
+
+        //-------------------------------------------------
+        // Query
+        //-------------------------------------------------
+
+        /*
+         * ----------------
+         * Example of usage
+         * ----------------
+         * sg::ecs::Query<MySettings> query;
+         * query.Require(MySettings::GetComponentId<CircleComponent>()).Exclude(MySettings::GetComponentId<InputComponent>());
+         * manager.ForEntitiesMatching(query, [](auto entityIndex, void* const* components)
+         * {
+         *     auto& circleComponent{ *static_cast<CircleComponent*>(components[0]) };
+         * });
+         */
+
+        /**
+         * @brief A signature built at runtime from component Ids.
+         * @tparam TSettings The Ecs settings and wrapper for the `ComponentList` and `SignatureList`.
+         */
+        template <typename TSettings>
+        class Query
+        {
+        private:
+            using Settings = TSettings;
+            using Bitset = typename Settings::Bitset;
+
+            Bitset m_required;
+            Bitset m_excluded;
+
+            /**
+             * @brief The required component Ids in the order of the `Require()` calls.
+             */
+            std::vector<std::size_t> m_componentIds;
+
+        public:
+            /**
+             * @brief Adds a required component. Its column pointer is passed to the callback.
+             * @param componentId The component Id.
+             * @return Reference to this query.
+             */
+            Query& Require(const std::size_t componentId)
+            {
+                assert(componentId < Settings::ComponentCount());
+
+                if (!m_required[componentId])
+                {
+                    m_required[componentId] = true;
+                    m_componentIds.push_back(componentId);
+                }
+
+                return *this;
+            }
+
+            /**
+             * @brief Adds an excluded component.
+             * @param componentId The component Id.
+             * @return Reference to this query.
+             */
+            Query& Exclude(const std::size_t componentId) noexcept
+            {
+                assert(componentId < Settings::ComponentCount());
+
+                m_excluded[componentId] = true;
+
+                return *this;
+            }
+
+            /**
+             * @brief Returns the required components.
+             * @return Const reference to the bitset.
+             */
+            const Bitset& GetRequiredBitset() const noexcept
+            {
+                return m_required;
+            }
+
+            /**
+             * @brief Returns the excluded components.
+             * @return Const reference to the bitset.
+             */
+            const Bitset& GetExcludedBitset() const noexcept
+            {
+                return m_excluded;
+            }
+
+            /**
+             * @brief Returns the required component Ids in the order of the `Require()` calls.
+             * @return Const reference to the Ids.
+             */
+            const std::vector<std::size_t>& GetComponentIds() const noexcept
+            {
+                return m_componentIds;
+            }
+        };
+
+        //-------------------------------------------------
+        // CommandBuffer
+        //-------------------------------------------------
+
+        /*
+         * ----------------
+         * Example of usage
+         * ----------------
+         * std::vector<sg::ecs::CommandBuffer<MySettings>> buffers;
+         * buffers.emplace_back(0); // one buffer per worker thread
+         * buffers.emplace_back(1);
+         *
+         * // on worker thread 1
+         * const auto bullet{ buffers[1].CreateIndex() };
+         * buffers[1].AddComponent<HealthComponent>(bullet, 1);
+         *
+         * // at the sync point
+         * manager.ApplyCommandBuffers(buffers);
+         */
+
+        /**
+         * @brief Handle of an entity whose creation is recorded in a `CommandBuffer`.
+         */
+        struct PendingEntity
+        {
+            std::size_t localIndex{ 0 };
+        };
+
+        /**
+         * @brief Records structural changes of one thread, which are applied to the `Manager` later.
+         *        Every thread owns its buffer, so recording needs no synchronization.
+         * @tparam TSettings The Ecs settings and wrapper for the `ComponentList` and `SignatureList`.
+         */
+        template <typename TSettings>
+        class CommandBuffer
+        {
+        public:
+            /**
+             * @brief Creates an empty buffer.
+             * @param threadIndex Buffers are applied in ascending order of this index.
+             */
+            explicit CommandBuffer(const std::size_t threadIndex = 0) noexcept
+                : m_threadIndex{ threadIndex }
+            {}
+
+            /**
+             * @brief Records the creation of an entity.
+             * @return A handle, which is valid for this buffer only.
+             */
+            PendingEntity CreateIndex()
+            {
+                m_commands.push_back({ CommandType::Create, 0, m_createCount, true, 0 });
+
+                return PendingEntity{ m_createCount++ };
+            }
+
+            /**
+             * @brief Records a kill.
+             * @param entityIndex The entity index.
+             */
+            void Kill(const EntityIndex entityIndex)
+            {
+                m_commands.push_back({ CommandType::Kill, 0, entityIndex, false, 0 });
+            }
+
+            /**
+             * @brief Records adding a component to an existing entity.
+             * @tparam TComponent The component type.
+             * @tparam TArgs The component parameter pack.
+             * @param entityIndex The entity index.
+             * @param args The component parameter pack.
+             */
+            template <typename TComponent, typename... TArgs>
+            void AddComponent(const EntityIndex entityIndex, TArgs&&... args)
+            {
+                RecordAddComponent<TComponent>(entityIndex, false, std::forward<decltype(args)>(args)...);
+            }
+
+            /**
+             * @brief Records adding a component to an entity created by this buffer.
+             * @tparam TComponent The component type.
+             * @tparam TArgs The component parameter pack.
+             * @param pendingEntity The handle returned by `CreateIndex()`.
+             * @param args The component parameter pack.
+             */
+            template <typename TComponent, typename... TArgs>
+            void AddComponent(const PendingEntity pendingEntity, TArgs&&... args)
+            {
+                RecordAddComponent<TComponent>(pendingEntity.localIndex, true, std::forward<decltype(args)>(args)...);
+            }
+
+            /**
+             * @brief Records deleting a component.
              * @tparam TComponent The component type.
              * @param entityIndex The entity index.
              */
             template <typename TComponent>
-            void DeleteComponent(const EntityIndex entityIndex) noexcept
+            void DeleteComponent(const EntityIndex entityIndex)
+            {
+                static_assert(Settings::template IsValidComponent<TComponent>(), "");
+
+                m_commands.push_back({ CommandType::DeleteComponent, Settings::template GetComponentId<TComponent>(), entityIndex, false, 0 });
+            }
+
+            /**
+             * @brief Returns the thread index of the buffer.
+             * @return std::size_t
+             */
+            std::size_t GetThreadIndex() const noexcept
+            {
+                return m_threadIndex;
+            }
+
+            /**
+             * @brief Returns the number of recorded entity creations.
+             * @return std::size_t
+             */
+            std::size_t GetCreateCount() const noexcept
+            {
+                return m_createCount;
+            }
+
+            /**
+             * @brief Removes all recorded commands.
+             */
+            void Clear() noexcept
+            {
+                m_commands.clear();
+                m_createCount = 0;
+
+                boost::mpl::for_each<typename Settings::ComponentList>([this](auto componentType)
+                {
+                    std::get<std::vector<decltype(componentType)>>(m_payloads).clear();
+                });
+            }
+
+        protected:
+
+        private:
+            using Settings = TSettings;
+
+            friend class Manager<Settings>;
+
+            enum class CommandType
+            {
+                Create,
+                Kill,
+                AddComponent,
+                DeleteComponent
+            };
+
+            /**
+             * @brief A single recorded command.
+             */
+            struct Command
+            {
+                CommandType type;
+                std::size_t componentId;
+
+                /**
+                 * @brief An entity index or, if `pending` is set, the local index of a created entity.
+                 */
+                std::size_t target;
+                bool pending;
+
+                /**
+                 * @brief Position of the component value in its payload vector.
+                 */
+                std::size_t payloadIndex;
+            };
+
+            /**
+             * @brief One vector of recorded component values for every component type.
+             */
+            using TupleOfPayloadVectors = typename TupleOfVectors<typename Settings::ComponentList>::type;
+
+            std::size_t m_threadIndex{ 0 };
+            std::size_t m_createCount{ 0 };
+            std::vector<Command> m_commands;
+            TupleOfPayloadVectors m_payloads;
+
+            template <typename TComponent, typename... TArgs>
+            void RecordAddComponent(const std::size_t target, const bool pending, TArgs&&... args)
+            {
+                static_assert(Settings::template IsValidComponent<TComponent>(), "");
+
+                auto& payloads{ std::get<std::vector<TComponent>>(m_payloads) };
+                payloads.push_back(TComponent(std::forward<decltype(args)>(args)...));
+
+                m_commands.push_back({ CommandType::AddComponent, Settings::template GetComponentId<TComponent>(), target, pending, payloads.size() - 1 });
+            }
+        };
+
+        //-------------------------------------------------
+        // Manager
+        //-------------------------------------------------
+
+        /*
+         * ----------------
+         * Example of usage
+         * ----------------
+         * using MyManager = sg::ecs::Manager<MySettings>;
+         */
+
+        template <typename TSettings>
+        EntityIndex MoveEntities(Manager<TSettings>& source, Span<const EntityIndex> entityIndices, Manager<TSettings>& destination, bool moveComponents = true);
+
+        /**
+         * @brief Describes how `ForEntitiesMatching()` finds the entities of a signature, see `Manager::PlanQuery()`.
+         */
+        struct QueryStats
+        {
+            /**
+             * @brief True if the population of `drivingComponentId` was walked instead of all entities.
+             */
+            bool usedPopulation{ false };
+
+            /**
+             * @brief The Id of the rarest required component. Only valid if `usedPopulation` is true.
+             */
+            std::size_t drivingComponentId{ 0 };
+
+            /**
+             * @brief The number of entities whose mask is tested.
+             */
+            std::size_t candidateCount{ 0 };
+        };
+
+        /**
+         * @brief Managed all entities and components at runtime.
+         * @tparam TSettings The Ecs settings and wrapper for the `ComponentList` and `SignatureList`.
+         */
+        template <typename TSettings>
+        class Manager
+        {
+        private:
+            using Settings = TSettings;
+            using ThisType = Manager<Settings>;
+            using ComponentStorage = ComponentStorage<Settings>;
+            using Bitset = typename Settings::Bitset;
+            using Entity = Entity<Settings>;
+            using SignatureBitsetsStorage = SignatureBitsetsStorage<Settings>;
+            using MaskWord = typename Settings::MaskWord;
+
+            static constexpr std::size_t MASK_WORDS{ Settings::MaskWordCount() };
+
+            template <typename T>
+            friend EntityIndex MoveEntities(Manager<T>& source, Span<const EntityIndex> entityIndices, Manager<T>& destination, bool moveComponents);
+
+            /**
+             * @brief The entities are stored contiguously in a `std::vector`.
+             */
+            std::vector<Entity> m_entities;
+
+            /**
+             * @brief A copy of every entity bitset as `MASK_WORDS` words, stored contiguously for vectorized matching.
+             */
+            std::vector<MaskWord> m_masks;
+
+            /**
+             * @brief Size of allocated storage capacity for m_entities.
+             */
+            std::size_t m_capacity{ 0 };
+
+            /**
+             * @brief Current size.
+             */
+            std::size_t m_size{ 0 };
+
+            /**
+             * @brief Next size.
+             */
+            std::size_t m_sizeNext{ 0 };
+
+            /**
+             * @brief The current `RefreshMode`.
+             */
+            RefreshMode m_refreshMode{ RefreshMode::SwapCompact };
+
+            /**
+             * @brief Killed entity slots waiting to be reused in `RefreshMode::FreeList` mode.
+             */
+            std::vector<EntityIndex> m_freeList;
+
+            /**
+             * @brief The size of `m_freeList` after the last `Refresh()`.
+             */
+            std::size_t m_freeCount{ 0 };
+
+            /**
+             * @brief Entities killed since the last `Refresh()`.
+             */
+            std::vector<EntityIndex> m_killed;
+
+            /**
+             * @brief Counts entities which were placed away from their `DataIndex` since the last compaction.
+             */
+            std::size_t m_displacedCount{ 0 };
+
+            /**
+             * @brief Run `CompactComponents()` every n-th `Refresh()`. `0` disables it.
+             */
+            std::size_t m_compactionInterval{ 0 };
+
+            /**
+             * @brief Run `CompactComponents()` when `GetFragmentation()` reaches this value. `0` disables it.
+             */
+            float m_compactionThreshold{ 0.0f };
+
+            /**
+             * @brief Number of `Refresh()` calls since the last compaction.
+             */
+            std::size_t m_refreshesSinceCompaction{ 0 };
+
+            /**
+             * @brief `ForEntitiesMatching()` prefetches the components of the match this far ahead. `0` disables it.
+             */
+            std::size_t m_prefetchDistance{ 0 };
+
+            /**
+             * @brief How `ForEntitiesMatching()` finds the matches.
+             */
+            ScanMode m_scanMode{ ScanMode::PerEntity };
+
+            /**
+             * @brief An owning group. Its members use the `DataIndex` slots [0, size).
+             */
+            struct Group
+            {
+                std::size_t signatureId{ 0 };
+                Bitset required;
+                Bitset excluded;
+                std::size_t size{ 0 };
+            };
+
+            /**
+             * @brief The owning groups, ordered from the outermost to the innermost group.
+             *        Every group contains the members of the groups behind it.
+             */
+            std::vector<Group> m_groups;
+
+            /**
+             * @brief Maps every `DataIndex` to the entity which currently uses it.
+             */
+            std::vector<EntityIndex> m_dataOwner;
+
+            /**
+             * @brief One bit per entity index for every component Id, set if the entity is alive and has the component.
+             */
+            std::array<std::vector<MaskWord>, Settings::ComponentCount()> m_populations;
+
+            /**
+             * @brief The number of set bits in every population.
+             */
+            std::array<std::size_t, Settings::ComponentCount()> m_populationCounts{};
+
+            /**
+             * @brief The change version at which the holders of a component changed inside a population word,
+             *        by adding, removing or killing or by moving an entity index, per component Id.
+             */
+            std::array<std::vector<ChangeVersion>, Settings::ComponentCount()> m_populationVersions;
+
+            /**
+             * @brief Changes whenever entities, masks or `DataIndex` slots change, which invalidates cached match lists.
+             */
+            std::size_t m_structureVersion{ 1 };
+
+            /**
+             * @brief The index and `DataIndex` of every entity matching a signature, valid for one structure version.
+             */
+            struct MatchCache
+            {
+                std::size_t structureVersion{ 0 };
+                std::vector<EntityIndex> entityIndices;
+                std::vector<DataIndex> dataIndices;
+            };
+
+            /**
+             * @brief One `MatchCache` per signature, used by `Gather()`, `Scatter()` and `View()`.
+             */
+            std::array<MatchCache, Settings::SignatureCount()> m_matchCaches;
+
+            class StampRun;
+
+            /**
+             * @brief The runs of the loops which are running on this manager, innermost first.
+             *        They are stamped before component slots move.
+             */
+            StampRun* m_stampRuns{ nullptr };
+
+            /**
+             * @brief Wrapper of `TupleOfSignatureBitsets`.
+             */
+            SignatureBitsetsStorage m_signatureBitsetsStorage;
+
+            /**
+             * @brief Wrapper of `TupleOfComponentVectors`.
+             */
+            ComponentStorage m_componentStorage;
+
+            /**
+             * @brief The forward and reverse indexes of all relation types.
+             */
+            RelationStorage<Settings> m_relationStorage;
+
+        public:
+            Manager()
+            {
+                GrowTo(DEFAULT_ENTITY_CAPACITY);
+            }
+
+            /**
+             * @brief Checks if the entity is alive.
+             * @param entityIndex The entity index.
+             * @return auto
+             */
+            auto IsAlive(const EntityIndex entityIndex) const noexcept
+            {
+                return GetEntity(entityIndex).alive;
+            }
+
+            /**
+             * @brief Kills an entity.
+             * @param entityIndex The entity index.
+             */
+            void Kill(const EntityIndex entityIndex)
+            {
+                auto& entity{ GetEntity(entityIndex) };
+                if (!entity.alive)
+                {
+                    return;
+                }
+
+                entity.alive = false;
+                SyncPopulations(entityIndex);
+                UpdateGroups(entityIndex);
+                m_relationStorage.RemoveAll(entityIndex);
+                m_killed.push_back(entityIndex);
+            }
+
+            /**
+             * @brief Creates a new entity.
+             *        In `RefreshMode::FreeList` mode a slot freed by an earlier `Refresh()` is reused. It lies in front
+             *        of `m_size` and is visited by queries at once, other new entities only after the next `Refresh()`.
+             *        A slot killed in the current frame is never handed out before the next `Refresh()`.
+             * @return std::size_t
+             */
+            auto CreateIndex()
+            {
+                // reuse a killed slot in O(1)
+                if (!m_freeList.empty())
+                {
+                    const auto freeIndex{ m_freeList.back() };
+                    m_freeList.pop_back();
+                    assert(!IsAlive(freeIndex));
+
+                    auto& entity{ m_entities[freeIndex] };
+                    entity.alive = true;
+                    entity.bitset.reset();
+                    SyncMask(freeIndex);
+
+                    return freeIndex;
+                }
+
+                GrowIfNeeded();
+
+                const auto freeIndex{ m_sizeNext++ };
+                assert(!IsAlive(freeIndex));
+
+                // the new created entity is alive
+                auto& entity{ m_entities[freeIndex] };
+                entity.alive = true;
+                entity.bitset.reset();
+                SyncMask(freeIndex);
+
+                if (entity.dataIndex != freeIndex)
+                {
+                    ++m_displacedCount;
+                }
+
+                return freeIndex;
+            }
+
+            /**
+             * @brief Creates `count` new entities at once, which all get the same components.
+             *        The range is contiguous and starts at the returned index.
+             * @tparam TComponents The component types.
+             * @param count The number of entities to create.
+             * @param prototypes The values copied into the components of every new entity.
+             * @return The index of the first new entity.
+             */
+            template <typename... TComponents>
+            EntityIndex CreateIndices(const std::size_t count, const TComponents&... prototypes)
+            {
+                static_assert(Settings::template AreValidComponents<TComponents...>(), "");
+
+                Bitset bitset;
+                using Expand = int[];
+                (void)Expand{ 0, (bitset[Settings::template GetComponentBit<TComponents>()] = true, 0)... };
+
+                const auto first{ CreateRange(count, bitset) };
+
+                // fill every column run by run
+                ForDataRuns(first, count, [this, &prototypes...](EntityIndex, const DataIndex dataFirst, const std::size_t runLength)
+                {
+                    (void)Expand{ 0, (m_componentStorage.Fill(dataFirst, runLength, prototypes), 0)... };
+                });
+
+                UpdateGroups(first, count);
+
+                return first;
+            }
+
+            /**
+             * @brief Creates `count` new entities from a `Prefab`.
+             *        The range is contiguous and starts at the returned index.
+             * @param prefab The prefab with the component mask and the prototype values.
+             * @param count The number of entities to create.
+             * @return The index of the first new entity.
+             */
+            EntityIndex Instantiate(const Prefab<Settings>& prefab, const std::size_t count = 1)
+            {
+                const auto first{ CreateRange(count, prefab.GetBitset()) };
+
+                // copy every prototype of the mask column by column
+                boost::mpl::for_each<typename Settings::ComponentList>([this, &prefab, first, count](auto componentType)
+                {
+                    using Component = decltype(componentType);
+
+                    if (!prefab.template Has<Component>())
+                    {
+                        return;
+                    }
+
+                    const auto& prototype{ prefab.template Get<Component>() };
+                    ForDataRuns(first, count, [this, &prototype](EntityIndex, const DataIndex dataFirst, const std::size_t runLength)
+                    {
+                        m_componentStorage.Fill(dataFirst, runLength, prototype);
+                    });
+                });
+
+                UpdateGroups(first, count);
+
+                return first;
+            }
+
+            /**
+             * @brief Creates `count` copies of an entity with all of its components.
+             *        The range is contiguous and starts at the returned index.
+             * @param entityIndex The index of the entity to copy.
+             * @param count The number of copies.
+             * @return The index of the first copy.
+             */
+            EntityIndex Clone(const EntityIndex entityIndex, const std::size_t count = 1)
+            {
+                assert(IsAlive(entityIndex));
+
+                // `CreateRange()` may grow `m_entities`, so copy the source metadata first
+                const auto bitset{ GetEntity(entityIndex).bitset };
+                const auto sourceDataIndex{ GetEntity(entityIndex).dataIndex };
+
+                const auto first{ CreateRange(count, bitset) };
+
+                boost::mpl::for_each<typename Settings::ComponentList>([this, &bitset, sourceDataIndex, first, count](auto componentType)
+                {
+                    using Component = decltype(componentType);
+
+                    if (!bitset[Settings::template GetComponentBit<Component>()])
+                    {
+                        return;
+                    }
+
+                    const auto& source{ m_componentStorage.template GetComponent<Component>(sourceDataIndex) };
+                    ForDataRuns(first, count, [this, &source](EntityIndex, const DataIndex dataFirst, const std::size_t runLength)
+                    {
+                        m_componentStorage.Fill(dataFirst, runLength, source);
+                    });
+                });
+
+                UpdateGroups(first, count);
+
+                return first;
+            }
+
+            /**
+             * @brief Creates one copy of every given entity with all of its components.
+             *        The range is contiguous and starts at the returned index.
+             * @param entityIndices The indices of the entities to copy.
+             * @return The index of the first copy.
+             */
+            EntityIndex CloneRange(const Span<const EntityIndex> entityIndices)
+            {
+                const auto count{ entityIndices.size() };
+                const auto first{ CreateRange(count, Bitset()) };
+
+                for (std::size_t i{ 0 }; i < count; ++i)
+                {
+                    assert(IsAlive(entityIndices[i]));
+                    m_entities[first + i].bitset = m_entities[entityIndices[i]].bitset;
+                    SyncMask(first + i);
+                }
+
+                // copy column by column
+                boost::mpl::for_each<typename Settings::ComponentList>([this, entityIndices, first, count](auto componentType)
+                {
+                    using Component = decltype(componentType);
+                    constexpr auto bit{ Settings::template GetComponentBit<Component>() };
+
+                    auto& components{ m_componentStorage.template GetComponentVector<Component>() };
+
+                    for (std::size_t i{ 0 }; i < count; ++i)
+                    {
+                        const auto& source{ m_entities[entityIndices[i]] };
+                        if (source.bitset[bit])
+                        {
+                            components[m_entities[first + i].dataIndex] = components[source.dataIndex];
+                            m_componentStorage.template MarkChanged<Component>(m_entities[first + i].dataIndex);
+                        }
+                    }
+                });
+
+                UpdateGroups(first, count);
+
+                return first;
+            }
+
+            /**
+             * @brief Applies the commands of all buffers in one pass and clears the buffers.
+             *        The buffers are merged deterministically: by thread index, then in recording order.
+             * @param commandBuffers The buffers, usually one per thread.
+             */
+            void ApplyCommandBuffers(const Span<CommandBuffer<Settings>> commandBuffers)
+            {
+                std::vector<CommandBuffer<Settings>*> sorted;
+                sorted.reserve(commandBuffers.size());
+
+                std::size_t createCount{ 0 };
+                for (auto& commandBuffer : commandBuffers)
+                {
+                    sorted.push_back(&commandBuffer);
+                    createCount += commandBuffer.GetCreateCount();
+                }
+
+                std::stable_sort(sorted.begin(), sorted.end(), [](const auto* lhs, const auto* rhs)
+                {
+                    return lhs->GetThreadIndex() < rhs->GetThreadIndex();
+                });
+
+                // grow only once for all recorded creations
+                if (m_sizeNext + createCount > m_capacity)
+                {
+                    GrowTo(std::max((m_capacity + 10) * 2, m_sizeNext + createCount));
+                }
+
+                std::vector<EntityIndex> created;
+
+                for (auto* commandBuffer : sorted)
+                {
+                    using CommandType = typename CommandBuffer<Settings>::CommandType;
+
+                    created.resize(commandBuffer->GetCreateCount());
+
+                    for (const auto& command : commandBuffer->m_commands)
+                    {
+                        const auto entityIndex{ command.pending ? created[command.target] : command.target };
+
+                        switch (command.type)
+                        {
+                        case CommandType::Create:
+                            created[command.target] = CreateIndex();
+                            break;
+                        case CommandType::Kill:
+                            Kill(entityIndex);
+                            break;
+                        case CommandType::AddComponent:
+                            GetComponentCommandFunctions()[command.componentId].add(*this, *commandBuffer, entityIndex, command.payloadIndex);
+                            break;
+                        case CommandType::DeleteComponent:
+                            GetComponentCommandFunctions()[command.componentId].remove(*this, entityIndex);
+                            break;
+                        }
+                    }
+
+                    commandBuffer->Clear();
+                }
+            }
+
+            /**
+             * @brief Clear the manager.
+             */
+            void Clear() noexcept
+            {
+                for (auto i{ 0u }; i < m_capacity; ++i)
+                {
+                    auto& entity(m_entities[i]);
+
+                    entity.dataIndex = i;
+                    entity.bitset.reset();
+                    entity.alive = false;
+                    m_dataOwner[i] = i;
+                }
+
+                std::fill(m_masks.begin(), m_masks.end(), MaskWord{ 0 });
+
+                for (auto& population : m_populations)
+                {
+                    std::fill(population.begin(), population.end(), MaskWord{ 0 });
+                }
+
+                m_populationCounts.fill(0);
+                MarkPopulationsChanged();
+                ++m_structureVersion;
+                m_relationStorage.Clear();
+
+                for (auto& group : m_groups)
+                {
+                    group.size = 0;
+                }
+
+                m_size = m_sizeNext = 0;
+                m_freeList.clear();
+                m_freeCount = 0;
+                m_killed.clear();
+                m_displacedCount = 0;
+                m_refreshesSinceCompaction = 0;
+            }
+
+            /**
+             * @brief Sets how killed entities are given back. Switching the mode refreshes the manager.
+             * @param refreshMode The new `RefreshMode`.
+             */
+            void SetRefreshMode(const RefreshMode refreshMode)
+            {
+                if (refreshMode == m_refreshMode)
+                {
+                    return;
+                }
+
+                // Compact with the old mode first, then with the new one, so that
+                // no dead entity is left in front of `m_size` without being tracked.
+                Refresh();
+                m_freeList.clear();
+                m_freeCount = 0;
+                m_refreshMode = refreshMode;
+
+                // the free list mode leaves dead slots behind which were never recorded as kills
+                if (m_refreshMode != RefreshMode::FreeList)
+                {
+                    for (EntityIndex index{ 0 }; index < m_sizeNext; ++index)
+                    {
+                        if (!m_entities[index].alive)
+                        {
+                            m_killed.push_back(index);
+                        }
+                    }
+                }
+
+                Refresh();
+            }
+
+            /**
+             * @brief Returns the current `RefreshMode`.
+             * @return RefreshMode
+             */
+            RefreshMode GetRefreshMode() const noexcept
+            {
+                return m_refreshMode;
+            }
+
+            /**
+             * @brief Rearranges entities.
+             */
+            void Refresh()
+            {
+                // cached match lists stay valid while no entity is created or killed
+                if (!m_killed.empty() || m_sizeNext != m_size)
+                {
+                    ++m_structureVersion;
+                }
+
+                // If no new entities have been created, set `m_size` to `0` and exit early.
+                if (m_sizeNext == 0)
+                {
+                    m_size = 0;
+                    return;
+                }
+
+                if (m_refreshMode == RefreshMode::FreeList)
+                {
+                    // The killed slots become reusable now, there is nothing to compact.
+                    m_freeList.insert(m_freeList.end(), m_killed.cbegin(), m_killed.cend());
+                    m_freeCount = m_freeList.size();
+                    m_killed.clear();
+                    m_size = m_sizeNext;
+                }
+                else
+                {
+                    // Otherwise, get the new `m_size` by calling `ArrangeAliveEntitiesToLeft()`.
+                    // After refreshing, `m_size` will equal `m_sizeNext`.
+                    // The final value for these variables will be calculated
+                    // by re-arranging entity metadata in the `m_entities` vector.
+                    m_size = m_sizeNext = m_refreshMode == RefreshMode::StableCompact ?
+                        SlideAliveEntitiesToLeft() : ArrangeAliveEntitiesToLeft();
+                    m_killed.clear();
+                }
+
+                CompactComponentsIfNeeded();
+            }
+
+            /**
+             * @brief Moves the component data so that the `DataIndex` of every entity equals its entity index.
+             *        Afterwards iterating the entities walks every component vector sequentially.
+             * @throws std::invalid_argument if owning groups exist, their slots must not move. Nothing is moved then.
+             */
+            void CompactComponents()
+            {
+                ThrowIfGroupsExist("CompactComponents: not available while owning groups exist");
+
+                FlushStampRuns();
+                auto& owner{ m_dataOwner };
+
+                for (EntityIndex index{ 0 }; index < m_size; ++index)
+                {
+                    const auto dataIndex{ m_entities[index].dataIndex };
+                    if (dataIndex == index)
+                    {
+                        continue;
+                    }
+
+                    // The entity which occupies the slot `index` takes over the slot `dataIndex`.
+                    ++m_structureVersion;
+                    const auto other{ owner[index] };
+                    m_componentStorage.SwapSlots(index, dataIndex);
+
+                    m_entities[other].dataIndex = dataIndex;
+                    owner[dataIndex] = other;
+
+                    m_entities[index].dataIndex = index;
+                    owner[index] = index;
+                }
+
+                m_displacedCount = 0;
+                m_refreshesSinceCompaction = 0;
+            }
+
+            /**
+             * @brief Orders the entities by a component and moves the component data along, so that later
+             *        iterations visit the entities in this order with sequential memory access.
+             *        The manager is refreshed first. Entities without the component follow the sorted ones
+             *        in their previous order. Entity indices change as they do on `Refresh()`.
+             * @tparam TComponent The component type.
+             * @tparam TCompare A callable type: `bool(const TComponent& lhs, const TComponent& rhs)`.
+             * @param compare Returns true if `lhs` is ordered before `rhs`.
+             * @param sortMode The `SortMode`.
+             * @throws std::invalid_argument if owning groups exist. Nothing is refreshed or moved then.
+             */
+            template <typename TComponent, typename TCompare>
+            void SortBy(TCompare&& compare, const SortMode sortMode = SortMode::Full)
+            {
+                static_assert(Settings::template IsValidComponent<TComponent>(), "");
+
+                ThrowIfGroupsExist("SortBy: not available while owning groups exist");
+
+                Refresh();
+
+                std::vector<EntityIndex> order(m_size);
+                for (EntityIndex index{ 0 }; index < m_size; ++index)
+                {
+                    order[index] = index;
+                }
+
+                // alive entities with the component first, then the other alive entities, then the dead ones
+                const auto bit{ Settings::template GetComponentBit<TComponent>() };
+                const auto sortedLast{ std::stable_partition(order.begin(), order.end(), [this, bit](const EntityIndex index)
+                {
+                    return m_entities[index].alive && m_entities[index].bitset[bit];
+                }) };
+
+                std::stable_partition(sortedLast, order.end(), [this](const EntityIndex index)
+                {
+                    return m_entities[index].alive;
+                });
+
+                const auto& components{ m_componentStorage.template GetComponentVector<TComponent>() };
+                const auto less = [this, &components, &compare](const EntityIndex lhs, const EntityIndex rhs)
+                {
+                    return compare(components[m_entities[lhs].dataIndex], components[m_entities[rhs].dataIndex]);
+                };
+
+                if (sortMode == SortMode::Insertion)
+                {
+                    InsertionSort(order.begin(), sortedLast, less);
+                }
+                else
+                {
+                    std::stable_sort(order.begin(), sortedLast, less);
+                }
+
+                ApplyOrder(order);
+            }
+
+            /**
+             * @brief Orders the entities of a hierarchy breadth-first: roots first, then all entities of depth 1,
+             *        then depth 2 and so on. The component data is moved along, so that a single linear
+             *        `ForEntitiesMatching()` pass visits every parent before its children, e.g. to propagate
+             *        world transforms top-down. Every entity has at most one target (its parent) in `TRelation`.
+             *        The manager is refreshed first. If the entities are still ordered by depth, only the
+             *        components are compacted if needed. `RefreshMode::StableCompact` keeps the order over kills.
+             * @tparam TRelation The relation type, e.g. `ChildOf`.
+             * @return True if entity indices changed.
+             * @throws std::invalid_argument if the relation contains a cycle. Nothing is moved then.
+             * @throws std::invalid_argument if owning groups exist. Nothing is refreshed or moved then.
+             */
+            template <typename TRelation>
+            bool SortHierarchy()
+            {
+                static_assert(Settings::template IsValidRelation<TRelation>(), "");
+
+                ThrowIfGroupsExist("SortHierarchy: not available while owning groups exist");
+
+                Refresh();
+
+                const auto relationId{ Settings::template GetRelationId<TRelation>() };
+                const auto parentOf = [this, relationId](const EntityIndex index)
+                {
+                    const auto parents{ m_relationStorage.GetTargets(relationId, index) };
+                    assert(parents.size() <= 1);
+
+                    return parents.empty() ? index : parents[0];
+                };
+
+                // a linear check is enough while the order holds: every parent comes first and the depths do not decrease
+                std::vector<std::size_t> depths(m_size, 0);
+                std::size_t previousDepth{ 0 };
+                auto ordered{ true };
+
+                for (EntityIndex index{ 0 }; index < m_size && ordered; ++index)
+                {
+                    if (!m_entities[index].alive)
+                    {
+                        continue;
+                    }
+
+                    const auto parent{ parentOf(index) };
+                    if (parent > index)
+                    {
+                        ordered = false;
+                        break;
+                    }
+
+                    depths[index] = parent == index ? 0 : depths[parent] + 1;
+                    ordered = depths[index] >= previousDepth;
+                    previousDepth = depths[index];
+                }
+
+                if (ordered)
+                {
+                    if (m_displacedCount > 0)
+                    {
+                        CompactComponents();
+                    }
+
+                    return false;
+                }
+
+                // depth of every entity by walking down from the roots
+                std::fill(depths.begin(), depths.end(), 0);
+                std::vector<EntityIndex> pending;
+
+                for (EntityIndex index{ 0 }; index < m_size; ++index)
+                {
+                    if (m_entities[index].alive && parentOf(index) == index)
+                    {
+                        pending.push_back(index);
+                    }
+                }
+
+                std::size_t reached{ 0 };
+                while (!pending.empty())
+                {
+                    const auto parent{ pending.back() };
+                    pending.pop_back();
+                    ++reached;
+
+                    for (const auto child : m_relationStorage.GetSources(relationId, parent))
+                    {
+                        if (child == parent)
+                        {
+                            continue;
+                        }
+
+                        depths[child] = depths[parent] + 1;
+                        pending.push_back(child);
+                    }
+                }
+
+                // alive entities by depth, then the dead ones
+                std::vector<EntityIndex> order(m_size);
+                for (EntityIndex index{ 0 }; index < m_size; ++index)
+                {
+                    order[index] = index;
+                }
+
+                const auto sortedLast{ std::stable_partition(order.begin(), order.end(), [this](const EntityIndex index)
+                {
+                    return m_entities[index].alive;
+                }) };
+
+                // a cycle has no root and is never reached
+                if (reached != static_cast<std::size_t>(sortedLast - order.begin()))
+                {
+                    throw std::invalid_argument("SortHierarchy: the relation contains a cycle");
+                }
+
+                std::stable_sort(order.begin(), sortedLast, [&depths](const EntityIndex lhs, const EntityIndex rhs)
+                {
+                    return depths[lhs] < depths[rhs];
+                });
+
+                ApplyOrder(order);
+
+                return true;
+            }
+
+            /**
+             * @brief Runs `CompactComponents()` on every n-th `Refresh()`.
+             * @param interval The number of refreshes between two compactions. `0` disables it.
+             */
+            void SetCompactionInterval(const std::size_t interval) noexcept
+            {
+                m_compactionInterval = interval;
+            }
+
+            /**
+             * @brief Runs `CompactComponents()` on `Refresh()` when `GetFragmentation()` reaches the threshold.
+             * @param threshold A value in the range (0, 1]. `0` disables it.
+             */
+            void SetCompactionThreshold(const float threshold) noexcept
+            {
+                m_compactionThreshold = threshold;
+            }
+
+            /**
+             * @brief While `ForEntitiesMatching()` processes an entity, the component slots of the entity
+             *        `distance` positions ahead (with `ScanMode::Blocks`, of the match `distance` positions ahead)
+             *        are prefetched in every column of the signature, also across block ends.
+             *        Pays off when the components are scattered, the world does not fit into the cache
+             *        and the callable does real work per entity, see `BenchmarkPrefetch()`.
+             * @param distance The number of entities to look ahead. `0` disables prefetching.
+             */
+            void SetPrefetchDistance(const std::size_t distance) noexcept
+            {
+                m_prefetchDistance = distance;
+            }
+
+            /**
+             * @brief Returns the prefetch distance of `ForEntitiesMatching()`.
+             * @return std::size_t
+             */
+            std::size_t GetPrefetchDistance() const noexcept
+            {
+                return m_prefetchDistance;
+            }
+
+            /**
+             * @brief Sets how `ForEntitiesMatching()` finds the matches of a signature.
+             * @param scanMode The new `ScanMode`.
+             */
+            void SetScanMode(const ScanMode scanMode) noexcept
+            {
+                m_scanMode = scanMode;
+            }
+
+            /**
+             * @brief Returns how `ForEntitiesMatching()` finds the matches of a signature.
+             * @return ScanMode
+             */
+            ScanMode GetScanMode() const noexcept
+            {
+                return m_scanMode;
+            }
+
+            /**
+             * @brief Estimates the share of alive entities whose components are not stored at their entity index.
+             * @return A value in the range [0, 1].
+             */
+            float GetFragmentation() const noexcept
+            {
+                if (m_size == 0)
+                {
+                    return 0.0f;
+                }
+
+                return std::min(1.0f, static_cast<float>(m_displacedCount) / static_cast<float>(m_size));
+            }
+
+            /**
+             * @brief Adds a component.
+             * @tparam TComponent The component type.
+             * @tparam TArgs The component parameter pack.
+             * @param entityIndex The entity index.
+             * @param args The component parameter pack.
+             * @return Reference to the component.
+             */
+            template <typename TComponent, typename... TArgs>
+            auto& AddComponent(const EntityIndex entityIndex, TArgs&&... args) noexcept
+            {
+                static_assert(Settings::template IsValidComponent<TComponent>(), "");
+
+                // update entity bitset
+                auto& entity{ GetEntity(entityIndex) };
+                entity.bitset[Settings::template GetComponentBit<TComponent>()] = true;
+                SyncMask(entityIndex);
+                UpdateGroups(entityIndex);
+
+                // get component for re-construct
+                auto& component{ m_componentStorage.template GetComponent<TComponent>(entity.dataIndex) };
+                m_componentStorage.template MarkChanged<TComponent>(entity.dataIndex);
+
+                // placement new (construct an object on memory that's already allocated)
+                new (&component) TComponent(std::forward<decltype(args)>(args)...);
+
+                return component;
+            }
+
+            /**
+             * @brief Checks if an entity is associated with a specific component type.
+             * @tparam TComponent The component type.
+             * @param entityIndex The entity index.
+             * @return bool
+             */
+            template <typename TComponent>
+            bool HasComponent(const EntityIndex entityIndex) const noexcept
+            {
+                static_assert(Settings::template IsValidComponent<TComponent>(), "");
+
+                return GetEntity(entityIndex).bitset[Settings::template GetComponentBit<TComponent>()];
+            }
+
+            /**
+             * @brief Clears the association between the entity and the component type.
+             * @tparam TComponent The component type.
+             * @param entityIndex The entity index.
+             */
+            template <typename TComponent>
+            void DeleteComponent(const EntityIndex entityIndex) noexcept
+            {
+                static_assert(Settings::template IsValidComponent<TComponent>(), "");
+
+                GetEntity(entityIndex).bitset[Settings::template GetComponentBit<TComponent>()] = false;
+                SyncMask(entityIndex);
+                UpdateGroups(entityIndex);
+            }
+
+            /**
+             * @brief Returns a reference to the component.
+             * @tparam TComponent The component type
+             * @param entityIndex The entity index
+             * @return Reference to the component.
+             */
+            template <typename TComponent>
+            auto& GetComponent(const EntityIndex entityIndex) noexcept
+            {
+                static_assert(Settings::template IsValidComponent<TComponent>(), "");
+
+                assert(HasComponent<TComponent>(entityIndex));
+
+                auto& entity{ GetEntity(entityIndex) };
+                m_componentStorage.template MarkChanged<TComponent>(entity.dataIndex);
+
+                return m_componentStorage.template GetComponent<TComponent>(entity.dataIndex);
+            }
+
+            /**
+             * @brief Returns a const reference to the component. The component is not marked as written.
+             * @tparam TComponent The component type
+             * @param entityIndex The entity index
+             * @return Const reference to the component.
+             */
+            template <typename TComponent>
+            const auto& GetComponent(const EntityIndex entityIndex) const noexcept
+            {
+                static_assert(Settings::template IsValidComponent<TComponent>(), "");
+
+                assert(HasComponent<TComponent>(entityIndex));
+
+                return m_componentStorage.template GetComponent<TComponent>(GetEntity(entityIndex).dataIndex);
+            }
+
+            /**
+             * @brief Checks if a entity matches a signature using `bitwise and` operation.
+             * @tparam TSignature The signature type.
+             * @param entityIndex The entity index.
+             * @return bool
+             */
+            template <typename TSignature>
+            auto MatchesSignature(const EntityIndex entityIndex) const noexcept
+            {
+                static_assert(Settings::template IsValidSignature<TSignature>(), "");
+
+                const auto& entityBitset{ GetEntity(entityIndex).bitset };
+                const auto& signatureBitset{ m_signatureBitsetsStorage.template GetSignatureBitset<TSignature>() };
+                const auto& excludedBitset{ m_signatureBitsetsStorage.template GetExcludedBitset<TSignature>() };
+
+                return (signatureBitset & entityBitset) == signatureBitset && (excludedBitset & entityBitset).none();
+            }
+
+            /**
+             * @brief Iterate over all alive entities.
+             * @tparam TCallable A callable type.
+             * @param callable A Closure to pass.
+             */
+            template <typename TCallable>
+            void ForEntities(TCallable&& callable)
+            {
+                for (EntityIndex index{ 0 }; index < m_size; ++index)
+                {
+                    // without compaction, dead slots stay in front of `m_size`
+                    if (m_refreshMode == RefreshMode::FreeList && !m_entities[index].alive)
+                    {
+                        continue;
+                    }
+
+                    callable(index);
+                }
+            }
+
+            /**
+             * @brief Iterate over all alive entities matching a particular signature.
+             *        Every entity is tested right before its callback runs, whichever way `PlanQuery()` chooses,
+             *        so entities killed or changed by an earlier callback are skipped as in a per-entity loop.
+             * @tparam TSignature The signature type.
+             * @tparam TCallable A callable type.
+             * @param callable A Closure to pass.
+             */
+            template <typename TSignature, typename TCallable>
+            void ForEntitiesMatching(TCallable&& callable)
+            {
+                static_assert(Settings::template IsValidSignature<TSignature>(), "");
+
+                MaskWord required[MASK_WORDS], excluded[MASK_WORDS];
+                GetSignatureMasks<TSignature>(required, excluded);
+
+                const auto stats{ PlanQuery<TSignature>() };
+
+                // Walk the rarest required component if it is selective enough.
+                if (stats.usedPopulation)
+                {
+                    EntityIndex first{ 0 };
+
+                    CallMatchBlocks<TSignature>(required, excluded, [this, &stats, required, excluded, &first](EntityIndex* matches, std::size_t& count)
+                    {
+                        if (first >= m_size)
+                        {
+                            return false;
+                        }
+
+                        count = PopulationMatches(stats.drivingComponentId, required, excluded, first, std::min(first + MATCH_BLOCK_SIZE, m_size), matches);
+                        first += MATCH_BLOCK_SIZE;
+
+                        return true;
+                    }, callable);
+
+                    return;
+                }
+
+                if (m_scanMode == ScanMode::Blocks)
+                {
+                    ForMatchBlocks<TSignature>(required, excluded, callable);
+
+                    return;
+                }
+
+                // test one mask after the other and call right away, without a list of matches
+                ChangeStamp<TSignature> stamp{ *this };
+
+                for (EntityIndex index{ 0 }; index < m_size; ++index)
+                {
+                    // the mask is tested once, when the entity is reached; prefetching a non-match only costs bandwidth
+                    if (m_prefetchDistance > 0 && index + m_prefetchDistance < m_size)
+                    {
+                        PrefetchSignature<TSignature>(m_entities[index + m_prefetchDistance].dataIndex);
+                    }
+
+                    if (!IsAliveMatch(index, required, excluded))
+                    {
+                        continue;
+                    }
+
+                    stamp.Call(index, callable);
+                }
+            }
+
+            /**
+             * @brief Iterate over those candidates which are alive and match a particular signature,
+             *        e.g. the result of a `SpatialGrid` query. The candidates are visited in the given order.
+             * @tparam TSignature The signature type.
+             * @tparam TCallable A callable type.
+             * @param candidates The entity indices to test.
+             * @param callable A Closure to pass.
+             */
+            template <typename TSignature, typename TCallable>
+            void ForEntitiesMatching(const Span<const EntityIndex> candidates, TCallable&& callable)
+            {
+                static_assert(Settings::template IsValidSignature<TSignature>(), "");
+
+                ChangeStamp<TSignature> stamp{ *this };
+
+                for (const auto entityIndex : candidates)
+                {
+                    if (entityIndex < m_sizeNext && m_entities[entityIndex].alive && MatchesSignature<TSignature>(entityIndex))
+                    {
+                        stamp.Call(entityIndex, callable);
+                    }
+                }
+            }
+
+            /**
+             * @brief Declares an owning group for a signature. The manager keeps all alive entities matching it
+             *        in the first `DataIndex` slots, so `ForEntitiesInGroup()` walks the component vectors linearly.
+             *        Several groups must be nested: each signature has to contain all terms of the other or vice versa.
+             *        While groups exist, `Refresh()` skips the automatic compaction and `CompactComponents()`,
+             *        `SortBy()` and `SortHierarchy()` throw `std::invalid_argument`.
+             * @tparam TSignature The signature type.
+             */
+            template <typename TSignature>
+            void AddGroup()
+            {
+                static_assert(Settings::template IsValidSignature<TSignature>(), "");
+
+                Group newGroup;
+                newGroup.signatureId = Settings::template GetSignatureId<TSignature>();
+                newGroup.required = m_signatureBitsetsStorage.template GetSignatureBitset<TSignature>();
+                newGroup.excluded = m_signatureBitsetsStorage.template GetExcludedBitset<TSignature>();
+
+                const auto contains = [](const Group& outer, const Group& inner)
+                {
+                    return (outer.required & inner.required) == outer.required && (outer.excluded & inner.excluded) == outer.excluded;
+                };
+
+                for (const auto& group : m_groups)
+                {
+                    assert(group.signatureId != newGroup.signatureId);
+                    assert(contains(group, newGroup) || contains(newGroup, group));
+                }
+
+                // keep the groups ordered from the outermost to the innermost
+                const auto position{ std::find_if(m_groups.cbegin(), m_groups.cend(), [&newGroup, &contains](const Group& group)
+                {
+                    return contains(newGroup, group);
+                }) };
+
+                m_groups.insert(position, newGroup);
+
+                // pack all members from scratch
+                for (auto& group : m_groups)
+                {
+                    group.size = 0;
+                }
+
+                UpdateGroups(0, m_sizeNext);
+            }
+
+            /**
+             * @brief Returns the number of entities in the group of a signature.
+             * @tparam TSignature The signature type.
+             * @return std::size_t
+             */
+            template <typename TSignature>
+            std::size_t GetGroupSize() const noexcept
+            {
+                return GetGroup<TSignature>().size;
+            }
+
+            /**
+             * @brief Iterate over all entities of the owning group of a signature.
+             *        No masks are tested and the components are read from consecutive slots.
+             * @tparam TSignature The signature type.
+             * @tparam TCallable A callable type.
+             * @param callable A Closure to pass.
+             */
+            template <typename TSignature, typename TCallable>
+            void ForEntitiesInGroup(TCallable&& callable)
+            {
+                using Helper = typename Rename<TSignature, ExpandCallHelper>::type;
+
+                const auto size{ GetGroup<TSignature>().size };
+                Helper::MarkWritten(*this, 0, size);
+
+                for (DataIndex dataIndex{ 0 }; dataIndex < size; ++dataIndex)
+                {
+                    Helper::CallAt(m_dataOwner[dataIndex], dataIndex, *this, callable);
+                }
+            }
+
+            /**
+             * @brief Iterate over all alive entities matching a runtime `Query`.
+             *        The callable gets the entity index and a pointer to each required component,
+             *        in the order of the `Query::Require()` calls: `callable(EntityIndex entityIndex, void* const* components)`.
+             * @tparam TCallable A callable type.
+             * @param query The query to match.
+             * @param callable A Closure to pass.
+             */
+            template <typename TCallable>
+            void ForEntitiesMatching(const Query<Settings>& query, TCallable&& callable)
+            {
+                MaskWord required[MASK_WORDS], excluded[MASK_WORDS];
+                Settings::ToMaskWords(query.GetRequiredBitset(), required);
+                Settings::ToMaskWords(query.GetExcludedBitset(), excluded);
+
+                // column base pointers and strides are looked up once per call
+                const auto& componentIds{ query.GetComponentIds() };
+                std::vector<char*> columns(componentIds.size());
+                std::vector<std::size_t> strides(componentIds.size());
+                std::vector<void*> components(componentIds.size());
+
+                for (std::size_t column{ 0 }; column < componentIds.size(); ++column)
+                {
+                    columns[column] = static_cast<char*>(m_componentStorage.GetColumnData(componentIds[column]));
+                    strides[column] = Settings::GetComponentSize(componentIds[column]);
+                }
+
+                EntityIndex matches[MATCH_BLOCK_SIZE];
+                DataIndex runFirst{ 0 };
+                std::size_t runLength{ 0 };
+
+                // every column counts as written, stamped once per run of contiguous slots
+                const auto markRun = [this, &componentIds, &runFirst, &runLength]()
+                {
+                    for (const auto componentId : componentIds)
+                    {
+                        m_componentStorage.MarkChanged(componentId, runFirst, runLength);
+                    }
+                };
+
+                for (EntityIndex first{ 0 }; first < m_size; first += MATCH_BLOCK_SIZE)
+                {
+                    const auto count{ RemoveDeadMatches(matches, MatchMasks(required, excluded, first, std::min(first + MATCH_BLOCK_SIZE, m_size), matches)) };
+
+                    for (std::size_t i{ 0 }; i < count; ++i)
+                    {
+                        const auto dataIndex{ m_entities[matches[i]].dataIndex };
+
+                        if (dataIndex != runFirst + runLength)
+                        {
+                            markRun();
+                            runFirst = dataIndex;
+                            runLength = 0;
+                        }
+
+                        ++runLength;
+
+                        for (std::size_t column{ 0 }; column < columns.size(); ++column)
+                        {
+                            components[column] = columns[column] + dataIndex * strides[column];
+                        }
+
+                        callable(matches[i], static_cast<void* const*>(components.data()));
+                    }
+                }
+
+                markRun();
+            }
+
+            /**
+             * @brief Returns the number of alive entities matching a signature.
+             *        Uses the same cached match list as `Gather()` and `Scatter()`.
+             * @tparam TSignature The signature type.
+             * @return std::size_t
+             */
+            template <typename TSignature>
+            std::size_t GetMatchCount()
+            {
+                return GetCachedDataIndices<TSignature>().size();
+            }
+
+            /**
+             * @brief Copies the components of all entities matching a signature into a dense buffer,
+             *        in entity order. Runs of contiguous `DataIndex` values are copied at once.
+             * @tparam TSignature The signature type.
+             * @tparam TComponent The component type.
+             * @param components The buffer, at least `GetMatchCount<TSignature>()` elements.
+             * @return The number of copied components.
+             */
+            template <typename TSignature, typename TComponent>
+            std::size_t Gather(const Span<TComponent> components)
+            {
+                static_assert(Settings::template IsValidComponent<TComponent>(), "");
+
+                const auto& dataIndices{ GetCachedDataIndices<TSignature>() };
+                assert(components.size() >= dataIndices.size());
+
+                const auto* column{ m_componentStorage.template GetComponentVector<TComponent>().data() };
+                ForCachedRuns(dataIndices, [column, &components](const std::size_t first, const DataIndex dataFirst, const std::size_t runLength)
+                {
+                    std::copy_n(column + dataFirst, runLength, components.data() + first);
+                });
+
+                return dataIndices.size();
+            }
+
+            /**
+             * @brief Copies one member of the components of all entities matching a signature into a dense buffer.
+             *        Example: `Gather<SignatureVelocity>(&CircleComponent::radius, Span<float>(radii))`.
+             * @tparam TSignature The signature type.
+             * @tparam TComponent The component type.
+             * @tparam TValue The member type.
+             * @tparam TBuffer The element type of the buffer, the same as `TValue`.
+             * @param member The member to copy.
+             * @param values The buffer, at least `GetMatchCount<TSignature>()` elements.
+             * @return The number of copied values.
+             */
+            template <typename TSignature, typename TComponent, typename TValue, typename TBuffer>
+            std::size_t Gather(TValue TComponent::* member, const Span<TBuffer> values)
+            {
+                static_assert(Settings::template IsValidComponent<TComponent>(), "");
+                static_assert(std::is_same<TBuffer, TValue>::value, "");
+
+                const auto& dataIndices{ GetCachedDataIndices<TSignature>() };
+                assert(values.size() >= dataIndices.size());
+
+                const auto* column{ m_componentStorage.template GetComponentVector<TComponent>().data() };
+                for (std::size_t i{ 0 }; i < dataIndices.size(); ++i)
+                {
+                    values[i] = column[dataIndices[i]].*member;
+                }
+
+                return dataIndices.size();
+            }
+
+            /**
+             * @brief Writes a dense buffer back into the components of all entities matching a signature,
+             *        in entity order. The counterpart of `Gather()`.
+             * @tparam TSignature The signature type.
+             * @tparam TComponent The component type.
+             * @param components The buffer, at least `GetMatchCount<TSignature>()` elements.
+             * @return The number of written components.
+             */
+            template <typename TSignature, typename TComponent>
+            std::size_t Scatter(const Span<const TComponent> components)
+            {
+                static_assert(Settings::template IsValidComponent<TComponent>(), "");
+
+                const auto& dataIndices{ GetCachedDataIndices<TSignature>() };
+                assert(components.size() >= dataIndices.size());
+
+                auto* column{ m_componentStorage.template GetComponentVector<TComponent>().data() };
+                ForCachedRuns(dataIndices, [this, column, &components](const std::size_t first, const DataIndex dataFirst, const std::size_t runLength)
+                {
+                    std::copy_n(components.data() + first, runLength, column + dataFirst);
+                    m_componentStorage.MarkChanged(Settings::template GetComponentId<TComponent>(), dataFirst, runLength);
+                });
+
+                return dataIndices.size();
+            }
+
+            /**
+             * @brief Writes a dense buffer back into one member of the components of all entities matching a signature.
+             * @tparam TSignature The signature type.
+             * @tparam TComponent The component type.
+             * @tparam TValue The member type.
+             * @tparam TBuffer The element type of the buffer, the same as `TValue`.
+             * @param member The member to write.
+             * @param values The buffer, at least `GetMatchCount<TSignature>()` elements.
+             * @return The number of written values.
+             */
+            template <typename TSignature, typename TComponent, typename TValue, typename TBuffer>
+            std::size_t Scatter(TValue TComponent::* member, const Span<const TBuffer> values)
+            {
+                static_assert(Settings::template IsValidComponent<TComponent>(), "");
+                static_assert(std::is_same<TBuffer, TValue>::value, "");
+
+                const auto& dataIndices{ GetCachedDataIndices<TSignature>() };
+                assert(values.size() >= dataIndices.size());
+
+                auto* column{ m_componentStorage.template GetComponentVector<TComponent>().data() };
+                for (std::size_t i{ 0 }; i < dataIndices.size(); ++i)
+                {
+                    column[dataIndices[i]].*member = values[i];
+                    m_componentStorage.template MarkChanged<TComponent>(dataIndices[i]);
+                }
+
+                return dataIndices.size();
+            }
+
+            /**
+             * @brief Adds the pair `source -> target` of a relation type, e.g. `AddRelation<ChildOf>(child, parent)`.
+             *        The pair is removed when one of both entities is killed and follows both through `Refresh()`.
+             * @tparam TRelation The relation type.
+             * @param source The source entity index.
+             * @param target The target entity index.
+             */
+            template <typename TRelation>
+            void AddRelation(const EntityIndex source, const EntityIndex target)
+            {
+                static_assert(Settings::template IsValidRelation<TRelation>(), "");
+                assert(IsAlive(source));
+                assert(IsAlive(target));
+
+                m_relationStorage.Add(Settings::template GetRelationId<TRelation>(), source, target);
+            }
+
+            /**
+             * @brief Removes the pair `source -> target` of a relation type.
+             * @tparam TRelation The relation type.
+             * @param source The source entity index.
+             * @param target The target entity index.
+             */
+            template <typename TRelation>
+            void RemoveRelation(const EntityIndex source, const EntityIndex target) noexcept
+            {
+                static_assert(Settings::template IsValidRelation<TRelation>(), "");
+
+                m_relationStorage.Remove(Settings::template GetRelationId<TRelation>(), source, target);
+            }
+
+            /**
+             * @brief Checks whether the pair `source -> target` of a relation type exists.
+             * @tparam TRelation The relation type.
+             * @param source The source entity index.
+             * @param target The target entity index.
+             * @return bool
+             */
+            template <typename TRelation>
+            bool HasRelation(const EntityIndex source, const EntityIndex target) const noexcept
+            {
+                static_assert(Settings::template IsValidRelation<TRelation>(), "");
+
+                return m_relationStorage.Has(Settings::template GetRelationId<TRelation>(), source, target);
+            }
+
+            /**
+             * @brief Returns all targets of a source, e.g. the parents of a child for `ChildOf`.
+             *        The span is valid until the next structural change.
+             * @tparam TRelation The relation type.
+             * @param source The source entity index.
+             * @return Span
+             */
+            template <typename TRelation>
+            Span<const EntityIndex> GetRelationTargets(const EntityIndex source) const noexcept
+            {
+                static_assert(Settings::template IsValidRelation<TRelation>(), "");
+
+                return m_relationStorage.GetTargets(Settings::template GetRelationId<TRelation>(), source);
+            }
+
+            /**
+             * @brief Returns all sources of a target in O(result), e.g. the children of a parent for `ChildOf`.
+             *        The span is valid until the next structural change.
+             * @tparam TRelation The relation type.
+             * @param target The target entity index.
+             * @return Span
+             */
+            template <typename TRelation>
+            Span<const EntityIndex> GetRelationSources(const EntityIndex target) const noexcept
+            {
+                static_assert(Settings::template IsValidRelation<TRelation>(), "");
+
+                return m_relationStorage.GetSources(Settings::template GetRelationId<TRelation>(), target);
+            }
+
+            /**
+             * @brief Runs several systems in one traversal. Every callable is invoked for the entities matching
+             *        the signature at the same position; per entity the callables run in the order given.
+             *        Example: `ForEntitiesMatchingFused<SignatureVelocity, SignatureLife>(move, heal)`.
+             * @tparam TSignatures The signature types.
+             * @tparam TCallables The callable types, one per signature.
+             * @param callables The Closures to pass.
+             */
+            template <typename... TSignatures, typename... TCallables>
+            void ForEntitiesMatchingFused(TCallables&&... callables)
+            {
+                static_assert(sizeof...(TSignatures) == sizeof...(TCallables), "");
+                static_assert(sizeof...(TSignatures) > 0, "");
+
+                auto tupleOfCallables{ std::forward_as_tuple(callables...) };
+
+                ForEntitiesMatchingFused<TSignatures...>(tupleOfCallables, std::index_sequence_for<TSignatures...>());
+            }
+
+            /**
+             * @brief Iterate over all alive entities matching a particular signature whose `TChanged` component
+             *        was written after `sinceVersion`. Blocks of `CHANGE_BLOCK_SIZE` slots without a newer write
+             *        are skipped. The entities are visited in `DataIndex` order.
+             * @tparam TSignature The signature type.
+             * @tparam TChanged A `Changed<TComponent>` type.
+             * @tparam TCallable A callable type.
+             * @param sinceVersion A version returned by `AdvanceChangeVersion()`.
+             * @param callable A Closure to pass.
+             */
+            template <typename TSignature, typename TChanged, typename TCallable>
+            void ForEntitiesMatching(const ChangeVersion sinceVersion, TCallable&& callable)
+            {
+                static_assert(Settings::template IsValidSignature<TSignature>(), "");
+
+                using Component = typename TChanged::Component;
+                static_assert(std::is_same<TChanged, Changed<Component>>::value, "");
+                static_assert(Settings::template IsValidComponent<Component>(), "");
+
+                using Helper = typename Rename<TSignature, ExpandCallHelper>::type;
+
+                ChangeStamp<TSignature> stamp{ *this };
+
+                ForChangedSlots<Component>(sinceVersion, [this, &stamp, &callable](const EntityIndex entityIndex, const DataIndex dataIndex)
+                {
+                    if (MatchesSignature<TSignature>(entityIndex))
+                    {
+                        stamp.Add(dataIndex);
+                        Helper::CallAt(entityIndex, dataIndex, *this, callable);
+                    }
+                });
+            }
+
+            /**
+             * @brief Iterate over all alive entities whose `TComponent` was written after `sinceVersion`.
+             *        The component is passed as const reference and is not marked as written again.
+             * @tparam TComponent The component type.
+             * @tparam TCallable A callable type: `void(EntityIndex entityIndex, const TComponent& component)`.
+             * @param sinceVersion A version returned by `AdvanceChangeVersion()`. `0` visits all components.
+             * @param callable A Closure to pass.
+             */
+            template <typename TComponent, typename TCallable>
+            void ForChangedComponents(const ChangeVersion sinceVersion, TCallable&& callable)
+            {
+                static_assert(Settings::template IsValidComponent<TComponent>(), "");
+
+                const auto& components{ m_componentStorage.template GetComponentVector<TComponent>() };
+                ForChangedSlots<TComponent>(sinceVersion, [&components, &callable](const EntityIndex entityIndex, const DataIndex dataIndex)
+                {
+                    callable(entityIndex, static_cast<const TComponent&>(components[dataIndex]));
+                });
+            }
+
+            /**
+             * @brief Iterate over the entity indices whose `TComponent` holder changed after `sinceVersion`: the component
+             *        was added or removed, the entity was killed or another entity moved to the index. Indices are visited
+             *        in blocks of 64 per changed population word, so unchanged neighbours are visited as well.
+             *        Unlike `GetStructureVersion()`, changes of other components are not reported.
+             * @tparam TComponent The component type.
+             * @tparam TCallable A callable type: `void(EntityIndex entityIndex, const TComponent* component)`,
+             *         the component is `nullptr` if no alive entity at the index has one.
+             * @param sinceVersion A version returned by `AdvanceChangeVersion()`. `0` visits all holders.
+             * @param callable A Closure to pass.
+             */
+            template <typename TComponent, typename TCallable>
+            void ForChangedHolders(const ChangeVersion sinceVersion, TCallable&& callable)
+            {
+                static_assert(Settings::template IsValidComponent<TComponent>(), "");
+
+                const auto componentId{ Settings::template GetComponentId<TComponent>() };
+                const auto& versions{ m_populationVersions[componentId] };
+                const auto& population{ m_populations[componentId] };
+                const auto& components{ m_componentStorage.template GetComponentVector<TComponent>() };
+
+                for (std::size_t word{ 0 }; word < versions.size(); ++word)
+                {
+                    if (versions[word] <= sinceVersion)
+                    {
+                        continue;
+                    }
+
+                    const auto last{ std::min((word + 1) * 64, m_capacity) };
+
+                    for (auto entityIndex{ word * 64 }; entityIndex < last; ++entityIndex)
+                    {
+                        const auto has{ (population[word] >> (entityIndex % 64) & 1) != 0 };
+                        const TComponent* component{ has ? &components[m_entities[entityIndex].dataIndex] : nullptr };
+
+                        callable(static_cast<EntityIndex>(entityIndex), component);
+                    }
+                }
+            }
+
+            /**
+             * @brief Returns the version which is stamped on written components.
+             * @return ChangeVersion
+             */
+            ChangeVersion GetChangeVersion() const noexcept
+            {
+                return m_componentStorage.GetChangeVersion();
+            }
+
+            /**
+             * @brief Returns a version which changes whenever entity indices, masks or `DataIndex` slots change.
+             *        Entity indices remembered from an older version may be stale.
+             * @return std::size_t
+             */
+            std::size_t GetStructureVersion() const noexcept
+            {
+                return m_structureVersion;
+            }
+
+            /**
+             * @brief Starts a new change version. `AddComponent()`, `GetComponent()` and the non-const
+             *        parameters of callbacks mark components as written with the current version.
+             * @return The previous version. Pass it as `sinceVersion` to visit only later writes.
+             */
+            ChangeVersion AdvanceChangeVersion() noexcept
+            {
+                return m_componentStorage.AdvanceChangeVersion();
+            }
+
+            /**
+             * @brief Iterate over all alive entities matching a particular signature in chunks.
+             *        A chunk is a run of matches with contiguous `DataIndex` values, so the callable gets
+             *        a `Span` of entity indices followed by one `Span` per required component:
+             *        `callable(Span<const EntityIndex> entityIndices, Span<TComponent>... components)`.
+             *        The runs come from the population bitmaps. While no component is displaced
+             *        (see `GetFragmentation()`), a run of entity indices is a chunk as a whole.
+             *        Signatures with `Optional` terms do not compile.
+             * @tparam TSignature The signature type.
+             * @tparam TCallable A callable type.
+             * @param callable A Closure to pass.
+             */
+            template <typename TSignature, typename TCallable>
+            void ForEachChunk(TCallable&& callable)
+            {
+                static_assert(Settings::template IsValidSignature<TSignature>(), "");
+
+                using Helper = typename Rename<TSignature, ExpandChunkHelper>::type;
+
+                const auto compact{ m_displacedCount == 0 };
+
+                ForMatchRuns<TSignature>([this, compact, &callable](const EntityIndex first, const std::size_t length)
+                {
+                    // the owners of a run of `DataIndex` slots are the entity indices of the chunk
+                    if (compact)
+                    {
+                        Helper::Call(*this, Span<const EntityIndex>(&m_dataOwner[first], length), first, callable);
+
+                        return;
+                    }
+
+                    std::size_t i{ 0 };
+                    while (i < length)
+                    {
+                        const auto dataFirst{ m_entities[first + i].dataIndex };
+                        std::size_t runLength{ 1 };
+
+                        while (i + runLength < length && m_entities[first + i + runLength].dataIndex == dataFirst + runLength)
+                        {
+                            ++runLength;
+                        }
+
+                        Helper::Call(*this, Span<const EntityIndex>(&m_dataOwner[dataFirst], runLength), dataFirst, callable);
+                        i += runLength;
+                    }
+                });
+            }
+
+            /**
+             * @brief Creates a range over all alive entities matching a particular signature,
+             *        which works with standard algorithms and range-based for loops.
+             *        The view shares the cached match list of the signature, so creating it
+             *        again without structural changes in between does not scan the entities.
+             *        Accessing the elements writes no change versions, so threads may share a view;
+             *        call `MarkWritten()` on the view after writing through it.
+             * @tparam TSignature The signature type.
+             * @return SignatureView
+             */
+            template <typename TSignature>
+            auto View()
+            {
+                static_assert(Settings::template IsValidSignature<TSignature>(), "");
+
+                return SignatureView<TSignature>(*this, GetMatchCache<TSignature>().entityIndices);
+            }
+
+            /**
+             * @brief Kills all alive entities matching a particular signature for which the predicate returns `true`.
+             *        Like other queries it visits the entities up to the last `Refresh()`, entities created since
+             *        then are kept. The kills are handed to the next `Refresh()` like single `Kill()` calls.
+             * @tparam TSignature The signature type.
+             * @tparam TPredicate A callable type with the same parameters as for `ForEntitiesMatching()`.
+             * @param predicate A Closure to pass.
+             * @return The number of killed entities.
+             */
+            template <typename TSignature, typename TPredicate>
+            std::size_t KillMatching(TPredicate&& predicate)
+            {
+                return KillMatching<TSignature>(std::forward<TPredicate>(predicate), [](const std::size_t taskCount, auto&& task)
+                {
+                    for (std::size_t taskIndex{ 0 }; taskIndex < taskCount; ++taskIndex)
+                    {
+                        task(taskIndex);
+                    }
+                });
+            }
+
+            /**
+             * @brief Like `KillMatching(predicate)`, but the entities are marked in tasks of `KILL_TASK_SIZE` entities
+             *        which the executor may run in parallel, e.g. on the thread pool of the application.
+             *        The kills are applied on the calling thread after the executor returned.
+             * @tparam TSignature The signature type.
+             * @tparam TPredicate A callable type with the same parameters as for `ForEntitiesMatching()`.
+             * @tparam TExecutor A callable type: `void(std::size_t taskCount, Task&& task)`.
+             * @param predicate A Closure to pass. It must be thread-safe if the executor runs tasks concurrently.
+             * @param executor Calls `task(taskIndex)` once for every index in [0, taskCount) and returns after all calls finished.
+             * @return The number of killed entities.
+             */
+            template <typename TSignature, typename TPredicate, typename TExecutor>
+            std::size_t KillMatching(TPredicate&& predicate, TExecutor&& executor)
+            {
+                static_assert(Settings::template IsValidSignature<TSignature>(), "");
+
+                MaskWord required[MASK_WORDS], excluded[MASK_WORDS];
+                GetSignatureMasks<TSignature>(required, excluded);
+
+                // Every task marks its own range and records its kills in ascending order.
+                const auto taskCount{ (m_size + KILL_TASK_SIZE - 1) / KILL_TASK_SIZE };
+                std::vector<std::vector<EntityIndex>> killedPerTask(taskCount);
+
+                executor(taskCount, [this, &predicate, &required, &excluded, &killedPerTask](const std::size_t taskIndex)
+                {
+                    const auto first{ taskIndex * KILL_TASK_SIZE };
+                    const auto last{ std::min(first + KILL_TASK_SIZE, m_size) };
+                    auto& killed{ killedPerTask[taskIndex] };
+                    EntityIndex matches[MATCH_BLOCK_SIZE];
+
+                    for (auto blockFirst{ first }; blockFirst < last; blockFirst += MATCH_BLOCK_SIZE)
+                    {
+                        const auto count{ MatchMasks(required, excluded, blockFirst, std::min(blockFirst + MATCH_BLOCK_SIZE, last), matches) };
+
+                        for (std::size_t i{ 0 }; i < count; ++i)
+                        {
+                            auto& entity{ m_entities[matches[i]] };
+                            if (entity.alive && this->template ExpandSignatureCall<TSignature>(matches[i], predicate))
+                            {
+                                entity.alive = false;
+                                killed.push_back(matches[i]);
+                            }
+                        }
+                    }
+                });
+
+                // feed the kills straight into the next refresh
+                std::size_t killedCount{ 0 };
+
+                for (const auto& killed : killedPerTask)
+                {
+                    m_killed.insert(m_killed.end(), killed.cbegin(), killed.cend());
+                    killedCount += killed.size();
+
+                    for (const auto entityIndex : killed)
+                    {
+                        SyncPopulations(entityIndex);
+                        UpdateGroups(entityIndex);
+                        m_relationStorage.RemoveAll(entityIndex);
+                    }
+                }
+
+                return killedCount;
+            }
+
+            /**
+             * @brief Kills all alive entities matching a particular signature.
+             * @tparam TSignature The signature type.
+             * @return The number of killed entities.
+             */
+            template <typename TSignature>
+            std::size_t KillAll()
+            {
+                return KillMatching<TSignature>([](auto&&...) { return true; });
+            }
+
+            /**
+             * @brief Returns the number of alive entities after the last `Refresh()` in every `RefreshMode`.
+             *        Kills and new entities are counted by the next `Refresh()`.
+             * @return std::size_t
+             */
+            std::size_t GetEntityCount() const noexcept
+            {
+                if (m_refreshMode == RefreshMode::FreeList)
+                {
+                    return m_size - m_freeCount;
+                }
+
+                return m_size;
+            }
+
+            /**
+             * @brief Returns the number of alive entities with a specific component type.
+             * @tparam TComponent The component type.
+             * @return std::size_t
+             */
+            template <typename TComponent>
+            std::size_t GetPopulation() const noexcept
+            {
+                static_assert(Settings::template IsValidComponent<TComponent>(), "");
+
+                return m_populationCounts[Settings::template GetComponentId<TComponent>()];
+            }
+
+            /**
+             * @brief Describes how `ForEntitiesMatching()` would find the entities of a signature right now:
+             *        the rarest required component drives the scan if its population is small enough.
+             *        Changes nothing, so it may be called while other threads iterate.
+             * @tparam TSignature The signature type.
+             * @return QueryStats
+             */
+            template <typename TSignature>
+            QueryStats PlanQuery() const noexcept
+            {
+                static_assert(Settings::template IsValidSignature<TSignature>(), "");
+
+                const auto& requiredBitset{ m_signatureBitsetsStorage.template GetSignatureBitset<TSignature>() };
+                auto drivingComponentId{ Settings::ComponentCount() };
+
+                for (std::size_t componentId{ 0 }; componentId < Settings::ComponentCount(); ++componentId)
+                {
+                    if (requiredBitset[componentId] &&
+                        (drivingComponentId == Settings::ComponentCount() || m_populationCounts[componentId] < m_populationCounts[drivingComponentId]))
+                    {
+                        drivingComponentId = componentId;
+                    }
+                }
+
+                QueryStats stats;
+                stats.candidateCount = m_size;
+
+                if (drivingComponentId < Settings::ComponentCount() && m_populationCounts[drivingComponentId] * POPULATION_SCAN_FACTOR < m_size)
+                {
+                    stats.usedPopulation = true;
+                    stats.drivingComponentId = drivingComponentId;
+                    stats.candidateCount = m_populationCounts[drivingComponentId];
+                }
+
+                return stats;
+            }
+
+            /**
+             * @brief Print the state of the entity metadata.
+             * @param oss std::ostream
+             */
+            void PrintState(std::ostream& oss) const
+            {
+                oss << "\nsize: " << m_size
+                    << "\nsizeNext: " << m_sizeNext
+                    << "\ncapacity: " << m_capacity
+                    << "\n";
+
+                for (auto i{ 0u }; i < m_sizeNext; ++i)
+                {
+                    auto& e(m_entities[i]);
+                    oss << (e.alive ? "A" : "D");
+                }
+
+                oss << "\n\n";
+            }
+
+        protected:
+
+        private:
+            /**
+             * @brief Grow entity and component vectors.
+             * @param newCapacity The new capacity.
+             */
+            void GrowTo(std::size_t newCapacity)
+            {
+                assert(newCapacity > m_capacity);
+
+                m_entities.resize(newCapacity);
+                m_masks.resize(newCapacity * MASK_WORDS);
+                m_dataOwner.resize(newCapacity);
+                m_componentStorage.GrowTo(newCapacity);
+                m_relationStorage.GrowTo(newCapacity);
+
+                for (auto& population : m_populations)
+                {
+                    population.resize((newCapacity + 63) / 64);
+                }
+
+                for (auto& versions : m_populationVersions)
+                {
+                    versions.resize((newCapacity + 63) / 64, 0);
+                }
+
+                // initialize the the entities to default values
+                for (auto i{ m_capacity }; i < newCapacity; ++i)
+                {
+                    auto& entity{ m_entities[i] };
+                    entity.dataIndex = i;
+                    entity.bitset.reset();
+                    entity.alive = false;
+                    m_dataOwner[i] = i;
+                }
+
+                m_capacity = newCapacity;
+            }
+
+            /**
+             * @brief Run `GrowTo()` with a fixed value, if needed.
+             */
+            void GrowIfNeeded()
+            {
+                if (m_capacity > m_sizeNext)
+                {
+                    return;
+                }
+
+                // `GrowTo()` with fixed value
+                GrowTo((m_capacity + 10) * 2);
+            }
+
+            /**
+             * @brief Brings `count` entities behind `m_sizeNext` to life with the same bitset.
+             *        The storage grows only once for the whole range.
+             * @param count The number of entities.
+             * @param bitset The bitset of every new entity.
+             * @return The index of the first new entity.
+             */
+            EntityIndex CreateRange(const std::size_t count, const Bitset& bitset)
+            {
+                const auto first{ m_sizeNext };
+
+                if (first + count > m_capacity)
+                {
+                    GrowTo(std::max((m_capacity + 10) * 2, first + count));
+                }
+
+                MaskWord mask[MASK_WORDS];
+                Settings::ToMaskWords(bitset, mask);
+
+                for (auto index{ first }; index < first + count; ++index)
+                {
+                    auto& entity{ m_entities[index] };
+                    assert(!entity.alive);
+
+                    entity.alive = true;
+                    entity.bitset = bitset;
+                    std::copy_n(mask, MASK_WORDS, &m_masks[index * MASK_WORDS]);
+                    SyncPopulations(index);
+
+                    if (entity.dataIndex != index)
+                    {
+                        ++m_displacedCount;
+                    }
+                }
+
+                m_sizeNext += count;
+
+                return first;
+            }
+
+            /**
+             * @brief Type-erased component functions, which are used to apply a `CommandBuffer`.
+             */
+            struct ComponentCommandFunctions
+            {
+                void (*add)(ThisType&, CommandBuffer<Settings>&, EntityIndex, std::size_t);
+                void (*remove)(ThisType&, EntityIndex);
+            };
+
+            /**
+             * @brief Returns a table with the `ComponentCommandFunctions` of every component type, indexed by the component Id.
+             * @return Const reference to the table.
+             */
+            static const auto& GetComponentCommandFunctions()
+            {
+                static const auto table
+                {
+                    []()
+                    {
+                        std::array<ComponentCommandFunctions, Settings::ComponentCount()> functions{};
+
+                        boost::mpl::for_each<typename Settings::ComponentList>([&functions](auto componentType)
+                        {
+                            using Component = decltype(componentType);
+
+                            functions[Settings::template GetComponentId<Component>()] =
+                            {
+                                [](ThisType& manager, CommandBuffer<Settings>& commandBuffer, const EntityIndex entityIndex, const std::size_t payloadIndex)
+                                {
+                                    auto& payloads{ std::get<std::vector<Component>>(commandBuffer.m_payloads) };
+                                    manager.template AddComponent<Component>(entityIndex, std::move(payloads[payloadIndex]));
+                                },
+                                [](ThisType& manager, const EntityIndex entityIndex)
+                                {
+                                    manager.template DeleteComponent<Component>(entityIndex);
+                                }
+                            };
+                        });
+
+                        return functions;
+                    }()
+                };
+
+                return table;
+            }
+
+            /**
+             * @brief Copies the bitset of an entity into `m_masks`.
+             * @param entityIndex The entity index.
+             */
+            void SyncMask(const EntityIndex entityIndex) noexcept
+            {
+                Settings::ToMaskWords(m_entities[entityIndex].bitset, &m_masks[entityIndex * MASK_WORDS]);
+                SyncPopulations(entityIndex);
+            }
+
+            /**
+             * @brief Updates the population bits of an entity from its mask and alive state.
+             * @param entityIndex The entity index.
+             */
+            void SyncPopulations(const EntityIndex entityIndex) noexcept
+            {
+                ++m_structureVersion;
+
+                const auto* mask{ &m_masks[entityIndex * MASK_WORDS] };
+                const auto alive{ m_entities[entityIndex].alive };
+                const auto bit{ MaskWord{ 1 } << (entityIndex % 64) };
+                const auto version{ m_componentStorage.GetChangeVersion() };
+
+                for (std::size_t componentId{ 0 }; componentId < Settings::ComponentCount(); ++componentId)
+                {
+                    const auto has{ alive && (mask[componentId / 64] >> (componentId % 64) & 1) != 0 };
+                    auto& word{ m_populations[componentId][entityIndex / 64] };
+
+                    if (has != ((word & bit) != 0))
+                    {
+                        word ^= bit;
+                        has ? ++m_populationCounts[componentId] : --m_populationCounts[componentId];
+                        m_populationVersions[componentId][entityIndex / 64] = version;
+                    }
+                }
+            }
+
+            /**
+             * @brief Rebuilds all populations from the masks.
+             */
+            void RebuildPopulations() noexcept
+            {
+                for (auto& population : m_populations)
+                {
+                    std::fill(population.begin(), population.end(), MaskWord{ 0 });
+                }
+
+                m_populationCounts.fill(0);
+                MarkPopulationsChanged();
+
+                for (EntityIndex index{ 0 }; index < m_sizeNext; ++index)
+                {
+                    SyncPopulations(index);
+                }
+            }
+
+            /**
+             * @brief Stamps the population words of a range of entity indices with the current change version,
+             *        e.g. after entities were reordered at once.
+             * @param first The first entity index.
+             * @param last One past the last entity index.
+             */
+            void MarkPopulationsChanged(const EntityIndex first = 0, const EntityIndex last = ~EntityIndex{ 0 }) noexcept
+            {
+                const auto version{ m_componentStorage.GetChangeVersion() };
+
+                for (auto& versions : m_populationVersions)
+                {
+                    const auto wordFirst{ std::min(first / 64, versions.size()) };
+                    const auto wordLast{ last / 64 < versions.size() ? (last + 63) / 64 : versions.size() };
+                    std::fill(versions.begin() + wordFirst, versions.begin() + std::max(wordFirst, wordLast), version);
+                }
+            }
+
+            /**
+             * @brief Walks the population of a component in [first, last) and collects the entities
+             *        matching the masks. The population holds only alive entities.
+             * @param componentId The driving component Id.
+             * @param required The required mask words.
+             * @param excluded The excluded mask words.
+             * @param first The first entity index.
+             * @param last One-past the last entity index.
+             * @param matches Receives the matching entity indices in ascending order. Must hold `last - first` values.
+             * @return The number of matches.
+             */
+            std::size_t PopulationMatches(const std::size_t componentId, const MaskWord* required, const MaskWord* excluded, const EntityIndex first, const EntityIndex last, EntityIndex* matches) const noexcept
+            {
+                const auto& population{ m_populations[componentId] };
+                std::size_t count{ 0 };
+
+                for (auto wordIndex{ first / 64 }; wordIndex * 64 < last; ++wordIndex)
+                {
+                    auto word{ population[wordIndex] };
+
+                    while (word != 0)
+                    {
+                        const auto index{ wordIndex * 64 + CountTrailingZeros(word) };
+                        word &= word - 1;
+
+                        if (index < first)
+                        {
+                            continue;
+                        }
+
+                        if (index >= last)
+                        {
+                            break;
+                        }
+
+                        matches[count] = index;
+                        count += MatchesMasks(index, required, excluded);
+                    }
+                }
+
+                return count;
+            }
+
+            /**
+             * @brief Finds the runs of consecutive alive entities in [0, `m_size`) matching a signature.
+             *        The matches of 64 entities are the AND of the required and the complement of the
+             *        excluded population words, so neither masks nor entities are read.
+             * @tparam TSignature The signature type.
+             * @tparam TCallable A callable type.
+             * @param callable Called with the first entity index and the length of each run.
+             */
+            template <typename TSignature, typename TCallable>
+            void ForMatchRuns(TCallable&& callable)
+            {
+                const auto& requiredBitset{ m_signatureBitsetsStorage.template GetSignatureBitset<TSignature>() };
+                const auto& excludedBitset{ m_signatureBitsetsStorage.template GetExcludedBitset<TSignature>() };
+
+                const MaskWord* required[Settings::ComponentCount()];
+                const MaskWord* excluded[Settings::ComponentCount()];
+                std::size_t requiredCount{ 0 }, excludedCount{ 0 };
+
+                for (std::size_t componentId{ 0 }; componentId < Settings::ComponentCount(); ++componentId)
+                {
+                    if (requiredBitset[componentId]) required[requiredCount++] = m_populations[componentId].data();
+                    if (excludedBitset[componentId]) excluded[excludedCount++] = m_populations[componentId].data();
+                }
+
+                EntityIndex runFirst{ 0 };
+                std::size_t runLength{ 0 };
+
+                for (std::size_t wordIndex{ 0 }; wordIndex * 64 < m_size; ++wordIndex)
+                {
+                    auto word{ ~MaskWord{ 0 } };
+
+                    for (std::size_t i{ 0 }; i < requiredCount; ++i) word &= required[i][wordIndex];
+                    for (std::size_t i{ 0 }; i < excludedCount; ++i) word &= ~excluded[i][wordIndex];
+
+                    // without required components, only the entity itself tells whether it is alive
+                    if (requiredCount == 0)
+                    {
+                        for (std::size_t bit{ 0 }; bit < 64 && wordIndex * 64 + bit < m_size; ++bit)
+                        {
+                            word &= ~(MaskWord{ !m_entities[wordIndex * 64 + bit].alive } << bit);
+                        }
+                    }
+
+                    if ((wordIndex + 1) * 64 > m_size)
+                    {
+                        word &= (MaskWord{ 1 } << (m_size % 64)) - 1;
+                    }
+
+                    while (word != 0)
+                    {
+                        const auto start{ CountTrailingZeros(word) };
+                        const auto rest{ ~(word >> start) };
+                        const auto length{ rest == 0 ? 64 - start : CountTrailingZeros(rest) };
+                        word = start + length == 64 ? 0 : word & ~(((MaskWord{ 1 } << length) - 1) << start);
+
+                        const auto first{ static_cast<EntityIndex>(wordIndex * 64 + start) };
+                        if (runLength > 0 && runFirst + runLength == first)
+                        {
+                            runLength += length;
+                            continue;
+                        }
+
+                        if (runLength > 0)
+                        {
+                            callable(runFirst, runLength);
+                        }
+
+                        runFirst = first;
+                        runLength = length;
+                    }
+                }
+
+                if (runLength > 0)
+                {
+                    callable(runFirst, runLength);
+                }
+            }
+
+            /**
+             * @brief Returns the index of the lowest set bit.
+             * @param word A non-zero word.
+             * @return std::size_t
+             */
+            static std::size_t CountTrailingZeros(const MaskWord word) noexcept
+            {
+#if defined(_MSC_VER)
+                unsigned long index;
+                _BitScanForward64(&index, word);
+                return index;
+#else
+                return static_cast<std::size_t>(__builtin_ctzll(word));
+#endif
+            }
+
+            /**
+             * @brief Swaps the metadata and masks of two entities.
+             * @param lhs The first entity index.
+             * @param rhs The second entity index.
+             *        The caller stamps the population versions of both indices.
+             */
+            void SwapEntities(const EntityIndex lhs, const EntityIndex rhs) noexcept
+            {
+                ++m_structureVersion;
+
+                std::swap(m_entities[lhs], m_entities[rhs]);
+                std::swap_ranges(&m_masks[lhs * MASK_WORDS], &m_masks[lhs * MASK_WORDS] + MASK_WORDS, &m_masks[rhs * MASK_WORDS]);
+
+                m_dataOwner[m_entities[lhs].dataIndex] = lhs;
+                m_dataOwner[m_entities[rhs].dataIndex] = rhs;
+                m_relationStorage.SwapEntities(lhs, rhs);
+
+                // the population bits of both entities differ only where their effective masks differ
+                const auto* lhsMask{ &m_masks[lhs * MASK_WORDS] };
+                const auto* rhsMask{ &m_masks[rhs * MASK_WORDS] };
+                const auto lhsAlive{ m_entities[lhs].alive ? ~MaskWord{ 0 } : MaskWord{ 0 } };
+                const auto rhsAlive{ m_entities[rhs].alive ? ~MaskWord{ 0 } : MaskWord{ 0 } };
+
+                for (std::size_t word{ 0 }; word < MASK_WORDS; ++word)
+                {
+                    auto diff{ (lhsMask[word] & lhsAlive) ^ (rhsMask[word] & rhsAlive) };
+
+                    while (diff != 0)
+                    {
+                        auto& population{ m_populations[word * 64 + CountTrailingZeros(diff)] };
+                        diff &= diff - 1;
+
+                        population[lhs / 64] ^= MaskWord{ 1 } << (lhs % 64);
+                        population[rhs / 64] ^= MaskWord{ 1 } << (rhs % 64);
+                    }
+                }
+            }
+
+            /**
+             * @brief Swaps the components of two `DataIndex` slots and updates the entities using them.
+             * @param lhs The first `DataIndex`.
+             * @param rhs The second `DataIndex`.
+             */
+            void SwapDataSlots(const DataIndex lhs, const DataIndex rhs)
+            {
+                if (lhs == rhs)
+                {
+                    return;
+                }
+
+                ++m_structureVersion;
+                FlushStampRuns();
+                m_componentStorage.SwapSlots(lhs, rhs);
+
+                const auto lhsOwner{ m_dataOwner[lhs] };
+                const auto rhsOwner{ m_dataOwner[rhs] };
+                m_displacedCount += 2;
+
+                m_entities[lhsOwner].dataIndex = rhs;
+                m_entities[rhsOwner].dataIndex = lhs;
+                m_dataOwner[lhs] = rhsOwner;
+                m_dataOwner[rhs] = lhsOwner;
+            }
+
+            /**
+             * @brief Checks whether an entity belongs to a group.
+             * @param entity The entity.
+             * @param group The group.
+             * @return bool
+             */
+            static bool MatchesGroup(const Entity& entity, const Group& group) noexcept
+            {
+                return entity.alive && (entity.bitset & group.required) == group.required && (entity.bitset & group.excluded).none();
+            }
+
+            /**
+             * @brief Moves an entity into or out of the owning groups after its bitset or state changed.
+             *        Leaving swaps its slot with the last member, entering with the first slot behind the group.
+             * @param entityIndex The entity index.
+             */
+            void UpdateGroups(const EntityIndex entityIndex)
+            {
+                if (m_groups.empty())
+                {
+                    return;
+                }
+
+                const auto& entity{ m_entities[entityIndex] };
+
+                // leave from the innermost group outwards
+                for (auto group{ m_groups.rbegin() }; group != m_groups.rend(); ++group)
+                {
+                    if (entity.dataIndex < group->size && !MatchesGroup(entity, *group))
+                    {
+                        SwapDataSlots(entity.dataIndex, --group->size);
+                    }
+                }
+
+                // enter from the outermost group inwards
+                for (auto& group : m_groups)
+                {
+                    if (entity.dataIndex >= group.size && MatchesGroup(entity, group))
+                    {
+                        SwapDataSlots(entity.dataIndex, group.size++);
+                    }
+                }
+            }
+
+            /**
+             * @brief Runs `UpdateGroups()` for a range of entities.
+             * @param first The first entity index.
+             * @param count The number of entities.
+             */
+            void UpdateGroups(const EntityIndex first, const std::size_t count)
+            {
+                if (m_groups.empty())
+                {
+                    return;
+                }
+
+                for (auto index{ first }; index < first + count; ++index)
+                {
+                    UpdateGroups(index);
+                }
+            }
+
+            /**
+             * @brief Returns the group of a signature.
+             * @tparam TSignature The signature type.
+             * @return Const reference to the group.
+             */
+            template <typename TSignature>
+            const Group& GetGroup() const noexcept
+            {
+                const auto group{ std::find_if(m_groups.cbegin(), m_groups.cend(), [](const Group& g)
+                {
+                    return g.signatureId == Settings::template GetSignatureId<TSignature>();
+                }) };
+
+                assert(group != m_groups.cend());
+
+                return *group;
+            }
+
+            /**
+             * @brief Converts the bitsets of a signature to mask words.
+             * @tparam TSignature The signature type.
+             * @param required Receives the required components.
+             * @param excluded Receives the components of the `Without` terms.
+             */
+            template <typename TSignature>
+            void GetSignatureMasks(MaskWord* required, MaskWord* excluded) const noexcept
+            {
+                Settings::ToMaskWords(m_signatureBitsetsStorage.template GetSignatureBitset<TSignature>(), required);
+                Settings::ToMaskWords(m_signatureBitsetsStorage.template GetExcludedBitset<TSignature>(), excluded);
+            }
+
+            /**
+             * @brief Collects the indices of all alive entities matching a signature.
+             * @tparam TSignature The signature type.
+             * @return The matching entity indices in ascending order.
+             */
+            template <typename TSignature>
+            std::vector<EntityIndex> CollectMatches() const
+            {
+                MaskWord required[MASK_WORDS], excluded[MASK_WORDS];
+                GetSignatureMasks<TSignature>(required, excluded);
+
+                std::vector<EntityIndex> matches(m_size);
+                matches.resize(RemoveDeadMatches(matches.data(), MatchMasks(required, excluded, 0, m_size, matches.data())));
+
+                return matches;
+            }
+
+            /**
+             * @brief Returns the `DataIndex` of every entity matching a signature, in entity order.
+             *        The list is rebuilt only if the structure changed since the last call.
+             * @tparam TSignature The signature type.
+             * @return Const reference to the cached list.
+             */
+            template <typename TSignature>
+            const std::vector<DataIndex>& GetCachedDataIndices()
+            {
+                static_assert(Settings::template IsValidSignature<TSignature>(), "");
+
+                return GetMatchCache<TSignature>().dataIndices;
+            }
+
+            /**
+             * @brief Returns the `MatchCache` of a signature, rebuilt only if the structure changed since the last call.
+             * @tparam TSignature The signature type.
+             * @return Const reference to the cache.
+             */
+            template <typename TSignature>
+            const MatchCache& GetMatchCache()
+            {
+                auto& cache{ m_matchCaches[Settings::template GetSignatureId<TSignature>()] };
+
+                if (cache.structureVersion != m_structureVersion)
+                {
+                    cache.entityIndices = CollectMatches<TSignature>();
+                    cache.dataIndices.resize(cache.entityIndices.size());
+
+                    for (std::size_t i{ 0 }; i < cache.entityIndices.size(); ++i)
+                    {
+                        cache.dataIndices[i] = m_entities[cache.entityIndices[i]].dataIndex;
+                    }
+
+                    cache.structureVersion = m_structureVersion;
+                }
+
+                return cache;
+            }
+
+            /**
+             * @brief Splits a list of `DataIndex` values into runs of contiguous values.
+             * @tparam TCallable A callable type.
+             * @param dataIndices The list.
+             * @param callable Called with the first list position, the first `DataIndex` and the length of each run.
+             */
+            template <typename TCallable>
+            static void ForCachedRuns(const std::vector<DataIndex>& dataIndices, TCallable&& callable)
+            {
+                std::size_t first{ 0 };
+
+                while (first < dataIndices.size())
+                {
+                    std::size_t runLength{ 1 };
+                    while (first + runLength < dataIndices.size() && dataIndices[first + runLength] == dataIndices[first] + runLength)
+                    {
+                        ++runLength;
+                    }
+
+                    callable(first, dataIndices[first], runLength);
+                    first += runLength;
+                }
+            }
+
+            /**
+             * @brief The `ScanMode::Blocks` part of `ForEntitiesMatching()`: matches a block of masks at once,
+             *        then drives the callbacks from the compact list.
+             * @tparam TSignature The signature type.
+             * @tparam TCallable A callable type.
+             * @param required The required mask words.
+             * @param excluded The excluded mask words.
+             * @param callable The Closure.
+             */
+            template <typename TSignature, typename TCallable>
+            void ForMatchBlocks(const MaskWord* required, const MaskWord* excluded, TCallable& callable)
+            {
+                EntityIndex first{ 0 };
+
+                CallMatchBlocks<TSignature>(required, excluded, [this, required, excluded, &first](EntityIndex* matches, std::size_t& count)
+                {
+                    if (first >= m_size)
+                    {
+                        return false;
+                    }
+
+                    count = RemoveDeadMatches(matches, MatchMasks(required, excluded, first, std::min(first + MATCH_BLOCK_SIZE, m_size), matches));
+                    first += MATCH_BLOCK_SIZE;
+
+                    return true;
+                }, callable);
+            }
+
+            /**
+             * @brief Calls the callable for every match of a sequence of match blocks. With a prefetch distance,
+             *        the next block is matched before the current one is processed, so the lookahead
+             *        continues across the block ends. A block is matched before its callbacks run, so once a
+             *        callback changed the structure, every further match is tested again right before its call.
+             * @tparam TSignature The signature type.
+             * @tparam TNextBlock A callable type.
+             * @tparam TCallable A callable type.
+             * @param required The required mask words.
+             * @param excluded The excluded mask words.
+             * @param nextBlock Fills `matches` and `count` with the next block and returns `false` if there is none.
+             * @param callable The Closure.
+             */
+            template <typename TSignature, typename TNextBlock, typename TCallable>
+            void CallMatchBlocks(const MaskWord* required, const MaskWord* excluded, TNextBlock&& nextBlock, TCallable& callable)
+            {
+                EntityIndex matches[2][MATCH_BLOCK_SIZE];
+                std::size_t counts[2]{ 0, 0 };
+                ChangeStamp<TSignature> stamp{ *this };
+                const auto structureVersion{ m_structureVersion };
+
+                if (m_prefetchDistance == 0)
+                {
+                    while (nextBlock(matches[0], counts[0]))
+                    {
+                        for (std::size_t i{ 0 }; i < counts[0]; ++i)
+                        {
+                            if (m_structureVersion == structureVersion || IsAliveMatch(matches[0][i], required, excluded))
+                            {
+                                stamp.Call(matches[0][i], callable);
+                            }
+                        }
+                    }
+
+                    return;
+                }
+
+                const auto distance{ std::min(m_prefetchDistance, MATCH_BLOCK_SIZE) };
+                std::size_t current{ 0 };
+                auto more{ nextBlock(matches[current], counts[current]) };
+
+                for (std::size_t i{ 0 }; more && i < std::min(distance, counts[current]); ++i)
+                {
+                    PrefetchSignature<TSignature>(m_entities[matches[current][i]].dataIndex);
+                }
+
+                while (more)
+                {
+                    const auto next{ 1 - current };
+                    counts[next] = 0;
+                    more = nextBlock(matches[next], counts[next]);
+
+                    const auto* currentMatches{ matches[current] };
+                    const auto* nextMatches{ matches[next] };
+                    const auto count{ counts[current] };
+
+                    // a block shorter than the distance leaves the first matches of the next block unprefetched
+                    std::size_t ahead{ count < distance ? std::min(distance - count, counts[next]) : 0 };
+                    for (std::size_t j{ 0 }; j < ahead; ++j)
+                    {
+                        PrefetchSignature<TSignature>(m_entities[nextMatches[j]].dataIndex);
+                    }
+
+                    // once the lookahead leaves the current block, `ahead` walks the next one
+                    for (std::size_t i{ 0 }; i < count; ++i)
+                    {
+                        if (i + distance < count)
+                        {
+                            PrefetchSignature<TSignature>(m_entities[currentMatches[i + distance]].dataIndex);
+                        }
+                        else if (ahead < counts[next])
+                        {
+                            PrefetchSignature<TSignature>(m_entities[nextMatches[ahead++]].dataIndex);
+                        }
+
+                        if (m_structureVersion == structureVersion || IsAliveMatch(currentMatches[i], required, excluded))
+                        {
+                            stamp.Call(currentMatches[i], callable);
+                        }
+                    }
+
+                    current = next;
+                }
+            }
+
+            /**
+             * @brief Checks whether the mask of an entity contains the `required` mask and shares no bit with the `excluded` mask.
+             * @param entityIndex The entity index.
+             * @param required The mask words, which must all be set.
+             * @param excluded The mask words, which must all be clear.
+             * @return bool
+             */
+            bool MatchesMasks(const EntityIndex entityIndex, const MaskWord* required, const MaskWord* excluded) const noexcept
+            {
+                const auto* mask{ &m_masks[entityIndex * MASK_WORDS] };
+
+                for (std::size_t word{ 0 }; word < MASK_WORDS; ++word)
+                {
+                    if ((mask[word] & required[word]) != required[word] || (mask[word] & excluded[word]) != 0)
+                    {
+                        return false;
+                    }
+                }
+
+                return true;
+            }
+
+            /**
+             * @brief Checks whether an entity is alive and matches the masks. Used right before a callback,
+             *        since earlier callbacks may have killed the entity or changed its components.
+             * @param entityIndex The entity index.
+             * @param required The mask words, which must all be set.
+             * @param excluded The mask words, which must all be clear.
+             * @return bool
+             */
+            bool IsAliveMatch(const EntityIndex entityIndex, const MaskWord* required, const MaskWord* excluded) const noexcept
+            {
+                // the entity is only touched for matches, whose callbacks read it anyway
+                return MatchesMasks(entityIndex, required, excluded) && m_entities[entityIndex].alive;
+            }
+
+            /**
+             * @brief Checks whether dead entities may lie in front of `m_size`: the free slots in
+             *        `RefreshMode::FreeList` mode, otherwise the entities killed since the last `Refresh()`.
+             * @return bool
+             */
+            bool HasDeadEntities() const noexcept
+            {
+                return m_refreshMode == RefreshMode::FreeList || !m_killed.empty();
+            }
+
+            /**
+             * @brief Removes dead entities from a list of matches, see `HasDeadEntities()`.
+             * @param matches The matching entity indices.
+             * @param count The number of matches.
+             * @return The number of remaining matches.
+             */
+            std::size_t RemoveDeadMatches(EntityIndex* matches, const std::size_t count) const noexcept
+            {
+                if (!HasDeadEntities())
+                {
+                    return count;
+                }
+
+                return std::remove_if(matches, matches + count, [this](const EntityIndex entityIndex)
+                {
+                    return !m_entities[entityIndex].alive;
+                }) - matches;
+            }
+
+            /**
+             * @brief Finds all entities in [first, last) whose mask contains the `required` mask and
+             *        shares no bit with the `excluded` mask.
+             *        With a single mask word, 4 (AVX2) or 8 (AVX-512) masks are tested per instruction.
+             * @param required The mask words, which must all be set.
+             * @param excluded The mask words, which must all be clear.
+             * @param first The first entity index.
+             * @param last One-past the last entity index.
+             * @param matches Receives the matching entity indices in ascending order. Must hold `last - first` values.
+             * @return The number of matches.
+             */
+            std::size_t MatchMasks(const MaskWord* required, const MaskWord* excluded, const EntityIndex first, const EntityIndex last, EntityIndex* matches) const noexcept
+            {
+                const auto* masks{ m_masks.data() };
+                std::size_t count{ 0 };
+                auto index{ first };
+
+                if (MASK_WORDS == 1)
+                {
+                    const auto requiredWord{ required[0] };
+                    const auto excludedWord{ excluded[0] };
+
+#if defined(__AVX512F__)
+                    const auto requiredVector{ _mm512_set1_epi64(static_cast<long long>(requiredWord)) };
+                    const auto excludedVector{ _mm512_set1_epi64(static_cast<long long>(excludedWord)) };
+                    for (; index + 8 <= last; index += 8)
+                    {
+                        const auto maskVector{ _mm512_loadu_si512(masks + index) };
+                        const auto bits
+                        {
+                            _mm512_cmpeq_epi64_mask(_mm512_and_si512(maskVector, requiredVector), requiredVector) &
+                            _mm512_testn_epi64_mask(maskVector, excludedVector)
+                        };
+
+                        for (auto lane{ 0u }; lane < 8; ++lane)
+                        {
+                            matches[count] = index + lane;
+                            count += (bits >> lane) & 1u;
+                        }
+                    }
+#elif defined(__AVX2__)
+                    const auto requiredVector{ _mm256_set1_epi64x(static_cast<long long>(requiredWord)) };
+                    const auto excludedVector{ _mm256_set1_epi64x(static_cast<long long>(excludedWord)) };
+                    for (; index + 4 <= last; index += 4)
+                    {
+                        const auto maskVector{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(masks + index)) };
+                        const auto hasRequired{ _mm256_cmpeq_epi64(_mm256_and_si256(maskVector, requiredVector), requiredVector) };
+                        const auto hasExcluded{ _mm256_cmpeq_epi64(_mm256_and_si256(maskVector, excludedVector), _mm256_setzero_si256()) };
+                        const auto equal{ _mm256_and_si256(hasRequired, hasExcluded) };
+                        const auto bits{ static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(equal))) };
+
+                        for (auto lane{ 0u }; lane < 4; ++lane)
+                        {
+                            matches[count] = index + lane;
+                            count += (bits >> lane) & 1u;
+                        }
+                    }
+#endif
+
+                    // scalar fallback and tail
+                    for (; index < last; ++index)
+                    {
+                        matches[count] = index;
+                        count += (masks[index] & requiredWord) == requiredWord && (masks[index] & excludedWord) == 0;
+                    }
+
+                    return count;
+                }
+
+                for (; index < last; ++index)
+                {
+                    auto matching{ true };
+                    for (std::size_t word{ 0 }; word < MASK_WORDS; ++word)
+                    {
+                        const auto mask{ masks[index * MASK_WORDS + word] };
+                        matching = matching && (mask & required[word]) == required[word] && (mask & excluded[word]) == 0;
+                    }
+
+                    matches[count] = index;
+                    count += matching;
+                }
+
+                return count;
+            }
+
+            /**
+             * @brief Owning groups keep their entities in the first slots, reordering the slots would break them.
+             * @param message The exception message.
+             */
+            void ThrowIfGroupsExist(const char* message) const
+            {
+                if (!m_groups.empty())
+                {
+                    throw std::invalid_argument(message);
+                }
+            }
+
+            /**
+             * @brief Run `CompactComponents()` if the interval or the fragmentation threshold is reached.
+             */
+            void CompactComponentsIfNeeded()
+            {
+                ++m_refreshesSinceCompaction;
+
+                // owning groups define their own layout
+                if (!m_groups.empty())
+                {
+                    return;
+                }
+
+                const auto intervalReached{ m_compactionInterval > 0 && m_refreshesSinceCompaction >= m_compactionInterval };
+                const auto thresholdReached{ m_compactionThreshold > 0.0f && GetFragmentation() >= m_compactionThreshold };
+
+                if (intervalReached || thresholdReached)
+                {
+                    CompactComponents();
+                }
+            }
+
+            /**
+             * @brief Matches every signature block by block and merges the sorted match lists,
+             *        so each entity is visited once for all of its signatures.
+             * @tparam TSignatures The signature types.
+             * @tparam TCallables A `std::tuple` of callable references.
+             * @tparam I The signature positions.
+             * @param callables The Closures.
+             */
+            template <typename... TSignatures, typename TCallables, std::size_t... I>
+            void ForEntitiesMatchingFused(TCallables& callables, std::index_sequence<I...>)
+            {
+                static constexpr std::size_t SIGNATURE_COUNT{ sizeof...(TSignatures) };
+
+                using Expand = int[];
+
+                MaskWord required[SIGNATURE_COUNT][MASK_WORDS], excluded[SIGNATURE_COUNT][MASK_WORDS];
+                (void)Expand{ 0, (GetSignatureMasks<TSignatures>(required[I], excluded[I]), 0)... };
+
+                EntityIndex matches[SIGNATURE_COUNT][MATCH_BLOCK_SIZE];
+                std::size_t counts[SIGNATURE_COUNT];
+                const auto structureVersion{ m_structureVersion };
+
+                for (EntityIndex first{ 0 }; first < m_size; first += MATCH_BLOCK_SIZE)
+                {
+                    const auto last{ std::min(first + MATCH_BLOCK_SIZE, m_size) };
+
+                    for (std::size_t k{ 0 }; k < SIGNATURE_COUNT; ++k)
+                    {
+                        counts[k] = RemoveDeadMatches(matches[k], MatchMasks(required[k], excluded[k], first, last, matches[k]));
+                    }
+
+                    (void)Expand{ 0, (MarkMatchesWritten<TSignatures>(matches[I], counts[I]), 0)... };
+
+                    std::size_t positions[SIGNATURE_COUNT]{};
+
+                    while (true)
+                    {
+                        // the next entity is the smallest head of all lists
+                        auto next{ last };
+                        for (std::size_t k{ 0 }; k < SIGNATURE_COUNT; ++k)
+                        {
+                            if (positions[k] < counts[k])
+                            {
+                                next = std::min(next, matches[k][positions[k]]);
+                            }
+                        }
+
+                        if (next == last)
+                        {
+                            break;
+                        }
+
+                        (void)Expand{ 0, (CallFusedStep<TSignatures>(next, matches[I], counts[I], positions[I], required[I], excluded[I], structureVersion, std::get<I>(callables)), 0)... };
+                    }
+                }
+            }
+
+            /**
+             * @brief Stamps the writable components of a list of matches, one run of contiguous slots at a time.
+             * @tparam TSignature The signature type.
+             * @param matches The entity indices.
+             * @param count The number of matches.
+             */
+            template <typename TSignature>
+            void MarkMatchesWritten(const EntityIndex* matches, const std::size_t count) noexcept
+            {
+                ChangeStamp<TSignature> stamp{ *this };
+
+                for (std::size_t i{ 0 }; i < count; ++i)
+                {
+                    stamp.Add(m_entities[matches[i]].dataIndex);
+                }
+            }
+
+            /**
+             * @brief Calls the callable of one signature if the entity is the head of its match list.
+             * @tparam TSignature The signature type.
+             * @tparam TCallable A callable type.
+             * @param entityIndex The entity index.
+             * @param matches The match list of the signature.
+             * @param count The number of matches.
+             * @param position The head of the match list.
+             * @param required The required mask words of the signature.
+             * @param excluded The excluded mask words of the signature.
+             * @param structureVersion The structure version when the blocks were matched.
+             * @param callable The Closure.
+             */
+            template <typename TSignature, typename TCallable>
+            void CallFusedStep(const EntityIndex entityIndex, const EntityIndex* matches, const std::size_t count, std::size_t& position,
+                const MaskWord* required, const MaskWord* excluded, const std::size_t structureVersion, TCallable& callable)
+            {
+                if (position < count && matches[position] == entityIndex)
+                {
+                    // an earlier callback may have changed the entity since the block was matched
+                    if (m_structureVersion == structureVersion || IsAliveMatch(entityIndex, required, excluded))
+                    {
+                        ExpandSignatureCall<TSignature>(entityIndex, callable);
+                    }
+
+                    ++position;
+                }
+            }
+
+            /**
+             * @brief Visits the slots of alive entities whose `TComponent` was written after `sinceVersion`.
+             *        Blocks of `CHANGE_BLOCK_SIZE` slots without a newer write are skipped.
+             * @tparam TComponent The component type.
+             * @tparam TCallable A callable type: `void(EntityIndex entityIndex, DataIndex dataIndex)`.
+             * @param sinceVersion The version.
+             * @param callable The Closure.
+             */
+            template <typename TComponent, typename TCallable>
+            void ForChangedSlots(const ChangeVersion sinceVersion, TCallable&& callable)
+            {
+                const auto componentId{ Settings::template GetComponentId<TComponent>() };
+                const auto& versions{ m_componentStorage.GetVersions(componentId) };
+                const auto& blockVersions{ m_componentStorage.GetBlockVersions(componentId) };
+                const auto& fullBlockVersions{ m_componentStorage.GetFullBlockVersions(componentId) };
+
+                for (std::size_t block{ 0 }; block < blockVersions.size(); ++block)
+                {
+                    if (blockVersions[block] <= sinceVersion)
+                    {
+                        continue;
+                    }
+
+                    const auto last{ std::min((block + 1) * CHANGE_BLOCK_SIZE, m_capacity) };
+                    const auto fullBlockChanged{ fullBlockVersions[block] > sinceVersion };
+
+                    for (auto dataIndex{ block * CHANGE_BLOCK_SIZE }; dataIndex < last; ++dataIndex)
+                    {
+                        if (!fullBlockChanged && versions[dataIndex] <= sinceVersion)
+                        {
+                            continue;
+                        }
+
+                        // slots of dead entities or of removed components keep their versions
+                        const auto entityIndex{ m_dataOwner[dataIndex] };
+                        if (entityIndex >= m_size || !m_entities[entityIndex].alive || !HasComponent<TComponent>(entityIndex))
+                        {
+                            continue;
+                        }
+
+                        callable(entityIndex, dataIndex);
+                    }
+                }
+            }
+
+            /**
+             * @brief Moves the entities into a new order and compacts the components to follow it.
+             *        Used by `SortBy()` and `SortHierarchy()`.
+             * @param order The old entity index of every new position in [0, m_size). The dead entities come last.
+             */
+            void ApplyOrder(const std::vector<EntityIndex>& order)
+            {
+                // apply the permutation with a scratch buffer
+                std::vector<Entity> entities(m_size);
+                std::vector<MaskWord> masks(m_size * MASK_WORDS);
+
+                for (EntityIndex index{ 0 }; index < m_size; ++index)
+                {
+                    entities[index] = m_entities[order[index]];
+                    std::copy_n(&m_masks[order[index] * MASK_WORDS], MASK_WORDS, &masks[index * MASK_WORDS]);
+                }
+
+                std::copy(entities.cbegin(), entities.cend(), m_entities.begin());
+                std::copy(masks.cbegin(), masks.cend(), m_masks.begin());
+
+                std::vector<EntityIndex> newIndices(m_size);
+                for (EntityIndex index{ 0 }; index < m_size; ++index)
+                {
+                    m_dataOwner[m_entities[index].dataIndex] = index;
+                    newIndices[order[index]] = index;
+                }
+
+                m_relationStorage.Remap(newIndices);
+                RebuildPopulations();
+
+                // the dead entities are now behind the alive ones
+                if (m_refreshMode == RefreshMode::FreeList)
+                {
+                    m_freeList.clear();
+
+                    for (auto index{ m_size }; index > 0 && !m_entities[index - 1].alive; --index)
+                    {
+                        m_freeList.push_back(index - 1);
+                    }
+
+                    m_freeCount = m_freeList.size();
+                }
+
+                CompactComponents();
+            }
+
+            /**
+             * @brief A stable insertion sort, which needs O(n) comparisons for sorted data.
+             * @tparam TIterator A random access iterator type.
+             * @tparam TLess A callable type.
+             * @param first The first element.
+             * @param last One past the last element.
+             * @param less The comparison.
+             */
+            template <typename TIterator, typename TLess>
+            static void InsertionSort(const TIterator first, const TIterator last, TLess&& less)
+            {
+                if (first == last)
+                {
+                    return;
+                }
+
+                for (auto current{ first + 1 }; current != last; ++current)
+                {
+                    auto value{ std::move(*current) };
+                    auto hole{ current };
+
+                    for (; hole != first && less(value, *(hole - 1)); --hole)
+                    {
+                        *hole = std::move(*(hole - 1));
+                    }
+
+                    *hole = std::move(value);
+                }
+            }
+
+            /**
+             * @brief Splits a range of entities into runs with contiguous `DataIndex` values.
+             * @tparam TCallable A callable type.
+             * @param first The first entity index of the range.
+             * @param count The number of entities.
+             * @param callable Called with the first entity index, the first `DataIndex` and the length of each run.
+             */
+            template <typename TCallable>
+            void ForDataRuns(const EntityIndex first, const std::size_t count, TCallable&& callable) const
+            {
+                const auto last{ first + count };
+                auto index{ first };
+
+                while (index < last)
+                {
+                    const auto dataFirst{ m_entities[index].dataIndex };
+                    std::size_t runLength{ 1 };
+
+                    while (index + runLength < last && m_entities[index + runLength].dataIndex == dataFirst + runLength)
+                    {
+                        ++runLength;
+                    }
+
+                    callable(index, dataFirst, runLength);
+                    index += runLength;
+                }
+            }
+
+            /**
+             * @brief Get entity by index.
+             * @param entityIndex The entity index.
+             * @return Reference to the entity.
+             */
+            auto& GetEntity(const EntityIndex entityIndex) noexcept
+            {
+                assert(m_sizeNext > entityIndex);
+                return m_entities[entityIndex];
+            }
+
+            /**
+             * @brief Get entity by index.
+             * @param entityIndex The entity index.
+             * @return Const reference to the entity.
+             */
+            const auto& GetEntity(const EntityIndex entityIndex) const noexcept
+            {
+                assert(m_sizeNext > entityIndex);
+                return m_entities[entityIndex];
+            }
+
+            /**
+             * @brief Alive entities found on the right will be swapped with dead entities found on the left.
+             *        Only the entities recorded in `m_killed` are visited, so the work is proportional
+             *        to the number of kills since the last `Refresh()`.
+             * @return The number of alive entities, which is one-past the index of the last alive entity.
+             */
+            EntityIndex ArrangeAliveEntitiesToLeft() noexcept
+            {
+                // The algorithm is implemented using two indices.
+                // * `iD` looks for dead entities, starting from the left.
+                // * `iA` looks for alive entities, starting from the right.
+                // Every dead entity has been recorded by `Kill()`, so instead of
+                // walking over alive entities, `iD` jumps through the sorted kills.
+
+                std::sort(m_killed.begin(), m_killed.end());
+                auto nextKill{ m_killed.cbegin() };
+
+                EntityIndex iD{ 0 }, iA{ m_sizeNext - 1 };
+
+                while (true)
+                {
+                    // Find first dead entity from the left.
+                    // If the next kill lies beyond the `iA` index, there
+                    // are no more dead entities in front of it and all
+                    // entities up to `iA` are alive.
+                    if (nextKill == m_killed.cend() || *nextKill > iA) return iA + 1;
+
+                    iD = *nextKill++;
+
+                    // Find first alive entity from the right.
+                    for (; true; --iA)
+                    {
+                        // In the case of alive entities, we have to perform
+                        // the checks done above in the reverse order.
+
+                        // If we found an alive entity, we immediately break
+                        // out of this inner for-loop.
+                        if (m_entities[iA].alive) break;
+
+                        // Otherwise, we acknowledge this is an entity that
+                        // has been killed since last refresh.
+                        // We will invalidate its handle here later.
+
+                        // If we reached `iD` or gone through it, we are
+                        // certain there are no more alive entities in the
+                        // entity metadata vector, and we can return `iD`.
+                        if (iA <= iD) return iD;
+                    }
+
+                    // If we arrived here, we have found two entities that
+                    // need to be swapped.
+
+                    // `iA` points to an alive entity, towards the right of
+                    // the vector.
+                    assert(m_entities[iA].alive);
+
+                    // `iD` points to a dead entity, towards the left of the
+                    // vector.
+                    assert(!m_entities[iD].alive);
+
+                    // Therefore, we swap them to arrange all alive entities
+                    // towards the left.
+                    SwapEntities(iA, iD);
+                    MarkPopulationsChanged(iA, iA + 1);
+                    MarkPopulationsChanged(iD, iD + 1);
+                    ++m_displacedCount;
+
+                    // After swapping, we will eventually need to refresh
+                    // the alive entity's handle and invalidate the dead
+                    // swapped entity's handle.
+
+                    // Move both "iterator" indices.
+                    ++iD; --iA;
+                }
+            }
+
+            /**
+             * @brief Alive entities are slid to the left over the dead entities, keeping their relative order.
+             *        The work starts at the first kill since the last `Refresh()`.
+             * @return The number of alive entities, which is one-past the index of the last alive entity.
+             */
+            EntityIndex SlideAliveEntitiesToLeft() noexcept
+            {
+                if (m_killed.empty())
+                {
+                    return m_sizeNext;
+                }
+
+                std::sort(m_killed.begin(), m_killed.end());
+
+                // All entities in [write, read) are dead. Every alive run between two kills
+                // is moved down to `write`, which pushes the dead entities behind it.
+                auto write{ m_killed.front() };
+
+                // every index behind the first kill changes, so its population words are stamped at once
+                MarkPopulationsChanged(write, m_sizeNext);
+
+                for (auto kill{ m_killed.cbegin() }; kill != m_killed.cend(); ++kill)
+                {
+                    const auto runLast{ kill + 1 == m_killed.cend() ? m_sizeNext : *(kill + 1) };
+
+                    for (auto read{ *kill + 1 }; read < runLast; ++read)
+                    {
+                        SwapEntities(write++, read);
+                        ++m_displacedCount;
+                    }
+                }
+
+                return write;
+            }
+
+            /**
+             * @brief Inner helper class. Turns a signature term into callable arguments:
+             *        a reference for a required component. `Get()` does not mark anything as written,
+             *        the loops call `MarkWritten()` for whole runs of slots instead.
+             * @tparam TTerm The signature term.
+             */
+            template <typename TTerm>
+            struct TermArguments
+            {
+                static constexpr bool WRITES{ true };
+
+                static std::tuple<TTerm&> Get(ThisType& manager, const EntityIndex, const DataIndex dataIndex) noexcept
+                {
+                    return std::tuple<TTerm&>(manager.m_componentStorage.template GetComponent<TTerm>(dataIndex));
+                }
+
+                static void MarkWritten(ThisType& manager, const DataIndex first, const std::size_t count) noexcept
+                {
+                    manager.m_componentStorage.MarkChanged(Settings::template GetComponentId<TTerm>(), first, count);
+                }
+
+                static void Prefetch(ThisType& manager, const DataIndex dataIndex) noexcept
+                {
+                    SG_ECS_PREFETCH(&manager.m_componentStorage.template GetComponent<TTerm>(dataIndex));
+                }
+            };
+
+            /**
+             * @brief `Without` terms are not passed.
+             * @tparam TComponents The component types.
+             */
+            template <typename... TComponents>
+            struct TermArguments<Without<TComponents...>>
+            {
+                static constexpr bool WRITES{ false };
+
+                static std::tuple<> Get(ThisType&, const EntityIndex, const DataIndex) noexcept
+                {
+                    return {};
+                }
+
+                static void MarkWritten(ThisType&, const DataIndex, const std::size_t) noexcept
+                {
+                }
+
+                static void Prefetch(ThisType&, const DataIndex) noexcept
+                {
+                }
+            };
+
+            /**
+             * @brief `Optional` terms are passed as pointers, which are `nullptr` for missing components.
+             * @tparam TComponents The component types.
+             */
+            template <typename... TComponents>
+            struct TermArguments<Optional<TComponents...>>
+            {
+                static constexpr bool WRITES{ true };
+
+                static std::tuple<TComponents*...> Get(ThisType& manager, const EntityIndex entityIndex, const DataIndex dataIndex) noexcept
+                {
+                    return std::tuple<TComponents*...>(GetOptional<TComponents>(manager, entityIndex, dataIndex)...);
+                }
+
+                template <typename TComponent>
+                static TComponent* GetOptional(ThisType& manager, const EntityIndex entityIndex, const DataIndex dataIndex) noexcept
+                {
+                    if (!manager.template HasComponent<TComponent>(entityIndex))
+                    {
+                        return nullptr;
+                    }
+
+                    return &manager.m_componentStorage.template GetComponent<TComponent>(dataIndex);
+                }
+
+                static void MarkWritten(ThisType& manager, const DataIndex first, const std::size_t count) noexcept
+                {
+                    using Expand = int[];
+                    (void)Expand{ 0, (MarkPresent<TComponents>(manager, first, count), 0)... };
+                }
+
+                // only the slots of entities which have the component were passed
+                template <typename TComponent>
+                static void MarkPresent(ThisType& manager, const DataIndex first, const std::size_t count) noexcept
+                {
+                    for (auto dataIndex{ first }; dataIndex < first + count; ++dataIndex)
+                    {
+                        if (manager.template HasComponent<TComponent>(manager.m_dataOwner[dataIndex]))
+                        {
+                            manager.m_componentStorage.template MarkChanged<TComponent>(dataIndex);
+                        }
+                    }
+                }
+
+                static void Prefetch(ThisType& manager, const DataIndex dataIndex) noexcept
+                {
+                    // every slot exists, so prefetch without looking at the bitset
+                    using Expand = int[];
+                    (void)Expand{ 0, (SG_ECS_PREFETCH(&manager.m_componentStorage.template GetComponent<TComponents>(dataIndex)), 0)... };
+                }
+            };
+
+            /**
+             * @brief `Read` terms are passed as const references and are not marked as changed.
+             * @tparam TComponents The component types.
+             */
+            template <typename... TComponents>
+            struct TermArguments<Read<TComponents...>>
+            {
+                static constexpr bool WRITES{ false };
+
+                static std::tuple<const TComponents&...> Get(ThisType& manager, const EntityIndex, const DataIndex dataIndex) noexcept
+                {
+                    return std::tuple<const TComponents&...>(manager.m_componentStorage.template GetComponent<TComponents>(dataIndex)...);
+                }
+
+                static void MarkWritten(ThisType&, const DataIndex, const std::size_t) noexcept
+                {
+                }
+
+                static void Prefetch(ThisType& manager, const DataIndex dataIndex) noexcept
+                {
+                    using Expand = int[];
+                    (void)Expand{ 0, (SG_ECS_PREFETCH(&manager.m_componentStorage.template GetComponent<TComponents>(dataIndex)), 0)... };
+                }
+            };
+
+            /**
+             * @brief Inner helper class. It contains a single static `call` function.
+             * @tparam TTerms A variadic number of signature terms.
+             */
+            template <typename... TTerms>
+            struct ExpandCallHelper
+            {
+                /**
+                 * @brief Expand the signature terms into component references and pointers.
+                 * @tparam TCallable A callable type.
+                 * @param entityIndex The index of the entity.
+                 * @param manager A reference to the caller manager.
+                 * @param callable The function to call.
+                 * @return The result of the callable.
+                 */
+                template<typename TCallable>
+                static decltype(auto) Call(const EntityIndex entityIndex, ThisType& manager, TCallable&& callable)
+                {
+                    auto arguments{ GetArguments(entityIndex, manager) };
+
+                    return Invoke(entityIndex, callable, arguments, std::make_index_sequence<std::tuple_size<decltype(arguments)>::value>());
+                }
+
+                /**
+                 * @brief Returns the component references and pointers of an entity as `std::tuple`.
+                 * @param entityIndex The index of the entity.
+                 * @param manager A reference to the caller manager.
+                 * @return std::tuple
+                 */
+                static auto GetArguments(const EntityIndex entityIndex, ThisType& manager) noexcept
+                {
+                    return GetArguments(entityIndex, manager.GetEntity(entityIndex).dataIndex, manager);
+                }
+
+                /**
+                 * @brief Returns the component references and pointers of an entity with a known `DataIndex`.
+                 * @param entityIndex The index of the entity.
+                 * @param dataIndex The `DataIndex` of the entity.
+                 * @param manager A reference to the caller manager.
+                 * @return std::tuple
+                 */
+                static auto GetArguments(const EntityIndex entityIndex, const DataIndex dataIndex, ThisType& manager) noexcept
+                {
+                    return std::tuple_cat(TermArguments<TTerms>::Get(manager, entityIndex, dataIndex)...);
+                }
+
+                /**
+                 * @brief Same as `Call()`, but without looking up the `DataIndex`.
+                 * @tparam TCallable A callable type.
+                 * @param entityIndex The index of the entity.
+                 * @param dataIndex The `DataIndex` of the entity.
+                 * @param manager A reference to the caller manager.
+                 * @param callable The function to call.
+                 * @return The result of the callable.
+                 */
+                template<typename TCallable>
+                static decltype(auto) CallAt(const EntityIndex entityIndex, const DataIndex dataIndex, ThisType& manager, TCallable&& callable)
+                {
+                    auto arguments{ GetArguments(entityIndex, dataIndex, manager) };
+
+                    return Invoke(entityIndex, callable, arguments, std::make_index_sequence<std::tuple_size<decltype(arguments)>::value>());
+                }
+
+                /**
+                 * @brief Prefetches the component slots of all terms.
+                 * @param manager A reference to the caller manager.
+                 * @param dataIndex The `DataIndex` of the entity.
+                 */
+                static void Prefetch(ThisType& manager, const DataIndex dataIndex) noexcept
+                {
+                    using Expand = int[];
+                    (void)Expand{ 0, (TermArguments<TTerms>::Prefetch(manager, dataIndex), 0)... };
+                }
+
+                /**
+                 * @brief Checks whether any term passes writable components.
+                 * @return bool
+                 */
+                static constexpr bool Writes() noexcept
+                {
+                    const bool writes[]{ false, TermArguments<TTerms>::WRITES... };
+
+                    for (const auto term : writes)
+                    {
+                        if (term)
+                        {
+                            return true;
+                        }
+                    }
+
+                    return false;
+                }
+
+                /**
+                 * @brief Stamps the writable components of a run of slots with the current change version.
+                 * @param manager A reference to the caller manager.
+                 * @param first The first `DataIndex` of the run.
+                 * @param count The number of slots.
+                 */
+                static void MarkWritten(ThisType& manager, const DataIndex first, const std::size_t count) noexcept
+                {
+                    using Expand = int[];
+                    (void)Expand{ 0, (TermArguments<TTerms>::MarkWritten(manager, first, count), 0)... };
+                }
+
+                /**
+                 * @brief Calls the callable with the entity index and the unpacked arguments.
+                 */
+                template<typename TCallable, typename TArguments, std::size_t... I>
+                static decltype(auto) Invoke(const EntityIndex entityIndex, TCallable&& callable, TArguments& arguments, std::index_sequence<I...>)
+                {
+                    return callable(entityIndex, std::get<I>(arguments)...);
+                }
+            };
+
+            /**
+             * @brief Inner helper class. Turns a signature term into a `Span` over a run of components.
+             * @tparam TTerm The signature term.
+             */
+            template <typename TTerm>
+            struct ChunkArguments
+            {
+                static std::tuple<Span<TTerm>> Get(ThisType& manager, const DataIndex dataFirst, const std::size_t count) noexcept
+                {
+                    manager.m_componentStorage.MarkChanged(Settings::template GetComponentId<TTerm>(), dataFirst, count);
+
+                    return std::tuple<Span<TTerm>>(Span<TTerm>(&manager.m_componentStorage.template GetComponent<TTerm>(dataFirst), count));
+                }
+            };
+
+            /**
+             * @brief `Read` terms are passed as spans of const components.
+             * @tparam TComponents The component types.
+             */
+            template <typename... TComponents>
+            struct ChunkArguments<Read<TComponents...>>
+            {
+                static std::tuple<Span<const TComponents>...> Get(ThisType& manager, const DataIndex dataFirst, const std::size_t count) noexcept
+                {
+                    return std::tuple<Span<const TComponents>...>(Span<const TComponents>(&manager.m_componentStorage.template GetComponent<TComponents>(dataFirst), count)...);
+                }
+            };
+
+            /**
+             * @brief `Optional` terms would need a `Span` with holes, so they are rejected.
+             * @tparam TComponents The component types.
+             */
+            template <typename... TComponents>
+            struct ChunkArguments<Optional<TComponents...>>
+            {
+                static_assert(sizeof...(TComponents) == 0, "ForEachChunk does not support Optional terms, use ForEntitiesMatching");
+
+                static std::tuple<> Get(ThisType&, const DataIndex, const std::size_t) noexcept
+                {
+                    return {};
+                }
+            };
+
+            /**
+             * @brief `Without` terms are not passed.
+             * @tparam TComponents The component types.
+             */
+            template <typename... TComponents>
+            struct ChunkArguments<Without<TComponents...>>
+            {
+                static std::tuple<> Get(ThisType&, const DataIndex, const std::size_t) noexcept
+                {
+                    return {};
+                }
+            };
+
+            /**
+             * @brief Inner helper class. It contains a single static `call` function for chunks.
+             * @tparam TTerms A variadic number of signature terms.
+             */
+            template <typename... TTerms>
+            struct ExpandChunkHelper
+            {
+                /**
+                 * @brief Expand the signature terms into component spans.
+                 * @tparam TCallable A callable type.
+                 * @param manager A reference to the caller manager.
+                 * @param entityIndices The entities of the chunk.
+                 * @param dataFirst The `DataIndex` of the first entity of the chunk.
+                 * @param callable The function to call.
+                 */
+                template<typename TCallable>
+                static void Call(ThisType& manager, const Span<const EntityIndex> entityIndices, const DataIndex dataFirst, TCallable&& callable)
+                {
+                    auto arguments{ std::tuple_cat(ChunkArguments<TTerms>::Get(manager, dataFirst, entityIndices.size())...) };
+
+                    Invoke(entityIndices, callable, arguments, std::make_index_sequence<std::tuple_size<decltype(arguments)>::value>());
+                }
+
+                /**
+                 * @brief Calls the callable with the entity indices and the unpacked spans.
+                 */
+                template<typename TCallable, typename TArguments, std::size_t... I>
+                static void Invoke(const Span<const EntityIndex> entityIndices, TCallable&& callable, TArguments& arguments, std::index_sequence<I...>)
+                {
+                    callable(entityIndices, std::get<I>(arguments)...);
+                }
+            };
+
+            /**
+             * @brief The pending run of contiguous `DataIndex` values of a `ChangeStamp`. While a writing loop
+             *        is running, its run is registered with the manager, so that a callback which moves component
+             *        slots, e.g. by joining an owning group, stamps the run before the slots move.
+             */
+            class StampRun
+            {
+            public:
+                using MarkWritten = void (*)(ThisType& manager, DataIndex first, std::size_t count);
+
+                /**
+                 * @brief Creates an empty run.
+                 * @param manager The manager.
+                 * @param markWritten Stamps a run, `nullptr` for loops which write nothing. Those are not registered,
+                 *        so read-only loops may run on several threads.
+                 */
+                StampRun(ThisType& manager, const MarkWritten markWritten) noexcept
+                    : m_manager{ manager }
+                    , m_markWritten{ markWritten }
+                    , m_next{ manager.m_stampRuns }
+                {
+                    if (m_markWritten)
+                    {
+                        manager.m_stampRuns = this;
+                    }
+                }
+
+                StampRun(const StampRun&) = delete;
+                StampRun& operator=(const StampRun&) = delete;
+
+                ~StampRun()
+                {
+                    if (m_markWritten)
+                    {
+                        Flush();
+
+                        // the loops end in reverse order
+                        assert(m_manager.m_stampRuns == this);
+                        m_manager.m_stampRuns = m_next;
+                    }
+                }
+
+                /**
+                 * @brief Adds a slot to the current run, or stamps the run and starts a new one.
+                 * @param dataIndex The `DataIndex`.
+                 */
+                void Add(const DataIndex dataIndex) noexcept
+                {
+                    if (!m_markWritten)
+                    {
+                        return;
+                    }
+
+                    if (m_count > 0 && dataIndex == m_first + m_count)
+                    {
+                        ++m_count;
+                        return;
+                    }
+
+                    Flush();
+                    m_first = dataIndex;
+                    m_count = 1;
+                }
+
+                /**
+                 * @brief Stamps the current run.
+                 */
+                void Flush() noexcept
+                {
+                    if (m_count > 0)
+                    {
+                        m_markWritten(m_manager, m_first, m_count);
+                        m_count = 0;
+                    }
+                }
+
+                /**
+                 * @brief Returns the run of the next outer loop.
+                 * @return StampRun*
+                 */
+                StampRun* GetNext() const noexcept
+                {
+                    return m_next;
+                }
+
+            protected:
+                ThisType& m_manager;
+
+            private:
+                MarkWritten m_markWritten;
+                StampRun* m_next;
+                DataIndex m_first{ 0 };
+                std::size_t m_count{ 0 };
+            };
+
+            /**
+             * @brief Stamps the pending runs of all running loops, see `StampRun`.
+             */
+            void FlushStampRuns() noexcept
+            {
+                for (auto* run{ m_stampRuns }; run != nullptr; run = run->GetNext())
+                {
+                    run->Flush();
+                }
+            }
+
+            /**
+             * @brief Collects the slots a loop passes to the callbacks of a signature into runs of
+             *        contiguous `DataIndex` values and stamps the writable components of each run at once.
+             *        It lives on the calling thread, the callbacks never write change versions.
+             * @tparam TSignature The signature type.
+             */
+            template <typename TSignature>
+            class ChangeStamp : public StampRun
+            {
+            private:
+                using Helper = typename Rename<TSignature, ExpandCallHelper>::type;
+
+            public:
+                explicit ChangeStamp(ThisType& manager) noexcept
+                    : StampRun{ manager, Helper::Writes() ? &Helper::MarkWritten : nullptr }
+                {}
+
+                /**
+                 * @brief Adds a slot and calls the callable of an entity.
+                 * @tparam TCallable A callable type.
+                 * @param entityIndex The entity index.
+                 * @param callable The Closure.
+                 */
+                template <typename TCallable>
+                void Call(const EntityIndex entityIndex, TCallable& callable)
+                {
+                    const auto dataIndex{ this->m_manager.m_entities[entityIndex].dataIndex };
+                    this->Add(dataIndex);
+                    Helper::CallAt(entityIndex, dataIndex, this->m_manager, callable);
+                }
+            };
+
+            /**
+             * @brief Rename TypeList to `ExpandCallHelper`.
+             * @tparam TSignature A signature type.
+             * @tparam TCallable A callable type.
+             * @param entityIndex The entity index.
+             * @param callable A Closure.
+             * @return The result of the closure.
+             */
+            template <typename TSignature, typename TCallable>
+            decltype(auto) ExpandSignatureCall(const EntityIndex entityIndex, TCallable&& callable)
+            {
+                static_assert(Settings::template IsValidSignature<TSignature>(), "");
+
+                using SignatureTerms = TSignature;
+                using Helper = typename Rename<SignatureTerms, ExpandCallHelper>::type;
+
+                return Helper::Call(entityIndex, *this, callable);
+            }
+
+            /**
+             * @brief Prefetches the component slots a signature accesses.
+             * @tparam TSignature A signature type.
+             * @param dataIndex The `DataIndex` of the entity.
+             */
+            template <typename TSignature>
+            void PrefetchSignature(const DataIndex dataIndex) noexcept
+            {
+                using Helper = typename Rename<TSignature, ExpandCallHelper>::type;
+
+                Helper::Prefetch(*this, dataIndex);
+            }
+
+        public:
+            /**
+             * @brief A range over all entities matching a signature.
+             *        Every element is a `std::tuple` with the entity index followed by the same
+             *        component references and pointers a `ForEntitiesMatching()` callback receives.
+             *        The view refers to the cached match list of the manager; structural changes invalidate it.
+             * @tparam TSignature The signature type.
+             */
+            template <typename TSignature>
+            class SignatureView
+            {
+            private:
+                using Helper = typename Rename<TSignature, ExpandCallHelper>::type;
+
+            public:
+                /**
+                 * @brief A tuple of the entity index and references to the components, like the callback parameters.
+                 */
+                using reference = decltype(std::tuple_cat(std::tuple<EntityIndex>(), Helper::GetArguments(0, std::declval<ThisType&>())));
+                using value_type = typename DecayTuple<reference>::type;
+
+                /**
+                 * @brief Random-access iterator over the matches. Like the iterators of zip ranges, dereferencing yields
+                 *        a `reference` tuple by value, whose references stay valid until the next structural change.
+                 *        The iterators can be split across threads or handed to parallel algorithms.
+                 */
+                class Iterator
+                {
+                public:
+                    using iterator_category = std::random_access_iterator_tag;
+                    using value_type = typename SignatureView::value_type;
+                    using difference_type = std::ptrdiff_t;
+                    using pointer = void;
+                    using reference = typename SignatureView::reference;
+
+                    Iterator() noexcept = default;
+
+                    Iterator(ThisType* manager, const EntityIndex* position) noexcept
+                        : m_manager{ manager }
+                        , m_position{ position }
+                    {}
+
+                    reference operator*() const noexcept
+                    {
+                        return std::tuple_cat(std::tuple<EntityIndex>(*m_position), Helper::GetArguments(*m_position, *m_manager));
+                    }
+
+                    reference operator[](const difference_type offset) const noexcept { return *(*this + offset); }
+
+                    Iterator& operator++() noexcept { ++m_position; return *this; }
+                    Iterator& operator--() noexcept { --m_position; return *this; }
+                    Iterator operator++(int) noexcept { auto copy{ *this }; ++m_position; return copy; }
+                    Iterator operator--(int) noexcept { auto copy{ *this }; --m_position; return copy; }
+                    Iterator& operator+=(const difference_type offset) noexcept { m_position += offset; return *this; }
+                    Iterator& operator-=(const difference_type offset) noexcept { m_position -= offset; return *this; }
+
+                    friend Iterator operator+(Iterator iterator, const difference_type offset) noexcept { return iterator += offset; }
+                    friend Iterator operator+(const difference_type offset, Iterator iterator) noexcept { return iterator += offset; }
+                    friend Iterator operator-(Iterator iterator, const difference_type offset) noexcept { return iterator -= offset; }
+                    friend difference_type operator-(const Iterator& lhs, const Iterator& rhs) noexcept { return lhs.m_position - rhs.m_position; }
+
+                    friend bool operator==(const Iterator& lhs, const Iterator& rhs) noexcept { return lhs.m_position == rhs.m_position; }
+                    friend bool operator!=(const Iterator& lhs, const Iterator& rhs) noexcept { return lhs.m_position != rhs.m_position; }
+                    friend bool operator<(const Iterator& lhs, const Iterator& rhs) noexcept { return lhs.m_position < rhs.m_position; }
+                    friend bool operator>(const Iterator& lhs, const Iterator& rhs) noexcept { return lhs.m_position > rhs.m_position; }
+                    friend bool operator<=(const Iterator& lhs, const Iterator& rhs) noexcept { return lhs.m_position <= rhs.m_position; }
+                    friend bool operator>=(const Iterator& lhs, const Iterator& rhs) noexcept { return lhs.m_position >= rhs.m_position; }
+
+                private:
+                    ThisType* m_manager{ nullptr };
+                    const EntityIndex* m_position{ nullptr };
+                };
+
+                SignatureView(ThisType& manager, const std::vector<EntityIndex>& matches) noexcept
+                    : m_manager{ &manager }
+                    , m_matches{ &matches }
+                {}
+
+                Iterator begin() const noexcept { return Iterator(m_manager, m_matches->data()); }
+                Iterator end() const noexcept { return Iterator(m_manager, m_matches->data() + m_matches->size()); }
+                std::size_t size() const noexcept { return m_matches->size(); }
+                bool empty() const noexcept { return m_matches->empty(); }
+                reference operator[](const std::size_t index) const noexcept { return begin()[index]; }
+
+                /**
+                 * @brief Marks the writable components of all elements as written, on the calling thread.
+                 *        Call it after writing through the view, e.g. once the threads sharing it have finished.
+                 */
+                void MarkWritten() const noexcept
+                {
+                    m_manager->template MarkMatchesWritten<TSignature>(m_matches->data(), m_matches->size());
+                }
+
+            private:
+                ThisType* m_manager;
+                const std::vector<EntityIndex>* m_matches;
+            };
+        };
+
+        //-------------------------------------------------
+        // Migration
+        //-------------------------------------------------
+
+        /*
+         * ----------------
+         * Example of usage
+         * ----------------
+         * const auto first{ sg::ecs::MoveEntities(westManager, leavingEntities, eastManager) };
+         */
+
+        /**
+         * @brief Transfers entities with their components from one manager to another.
+         *        The new entities form a contiguous range in the destination. The source
+         *        entities are killed, so the source needs a `Refresh()` afterwards.
+         * @tparam TSettings The Ecs settings and wrapper for the `ComponentList` and `SignatureList`.
+         * @param source The manager to take the entities from.
+         * @param entityIndices The indices of the entities in the source.
+         * @param destination The manager to put the entities in.
+         * @param moveComponents Move the component values instead of copying them.
+         * @return The index of the first new entity in the destination.
+         */
+        template <typename TSettings>
+        EntityIndex MoveEntities(Manager<TSettings>& source, const Span<const EntityIndex> entityIndices, Manager<TSettings>& destination, const bool moveComponents)
+        {
+            assert(&source != &destination);
+
+            const auto count{ entityIndices.size() };
+            const auto first{ destination.CreateRange(count, typename TSettings::Bitset()) };
+
+            for (std::size_t i{ 0 }; i < count; ++i)
+            {
+                assert(source.IsAlive(entityIndices[i]));
+                destination.m_entities[first + i].bitset = source.GetEntity(entityIndices[i]).bitset;
+                destination.SyncMask(first + i);
+            }
+
+            // transfer the whole batch column by column
+            boost::mpl::for_each<typename TSettings::ComponentList>([&source, &destination, entityIndices, first, count, moveComponents](auto componentType)
             {
-                static_assert(Settings::template IsValidComponent<TComponent>(), "");
+                using Component = decltype(componentType);
+                constexpr auto bit{ TSettings::template GetComponentBit<Component>() };
 
-                GetEntity(entityIndex).bitset[Settings::template GetComponentBit<TComponent>()] = false;
+                auto& from{ source.m_componentStorage.template GetComponentVector<Component>() };
+                auto& to{ destination.m_componentStorage.template GetComponentVector<Component>() };
+
+                for (std::size_t i{ 0 }; i < count; ++i)
+                {
+                    const auto& entity{ source.GetEntity(entityIndices[i]) };
+                    if (!entity.bitset[bit])
+                    {
+                        continue;
+                    }
+
+                    auto& component{ to[destination.m_entities[first + i].dataIndex] };
+                    if (moveComponents)
+                    {
+                        component = std::move(from[entity.dataIndex]);
+                    }
+                    else
+                    {
+                        component = from[entity.dataIndex];
+                    }
+
+                    destination.m_componentStorage.template MarkChanged<Component>(destination.m_entities[first + i].dataIndex);
+                }
+            });
+
+            destination.UpdateGroups(first, count);
+
+            for (const auto entityIndex : entityIndices)
+            {
+                source.Kill(entityIndex);
             }
 
+            return first;
+        }
+
+        //-------------------------------------------------
+        // SpatialGrid
+        //-------------------------------------------------
+
+        /*
+         * ----------------
+         * Example of usage
+         * ----------------
+         * sg::ecs::SpatialGrid<MySettings, PositionComponent> grid{ 4.0f };
+         * grid.Update(manager);
+         * grid.QueryRadius(x, y, 10.0f, candidates);
+         * manager.ForEntitiesMatching<SignatureMove>(candidates, callable);
+         */
+
+        /**
+         * @brief A spatial hash grid over all entities with a position component, which needs the float members `x` and `y`.
+         *        Cells are hashed into a fixed number of buckets, so the world needs no bounds.
+         *        `Update()` rebuilds the grid after structural changes, e.g. `Refresh()`, and otherwise moves
+         *        only the entities whose position was written since the last `Update()`.
+         * @tparam TSettings The Ecs settings and wrapper for the `ComponentList` and `SignatureList`.
+         * @tparam TPosition The position component type.
+         */
+        template <typename TSettings, typename TPosition>
+        class SpatialGrid
+        {
+        public:
+            using Settings = TSettings;
+
+            static_assert(Settings::template IsValidComponent<TPosition>(), "");
+
             /**
-             * @brief Returns a reference to the component.
-             * @tparam TComponent The component type
-             * @param entityIndex The entity index
-             * @return Reference to the component.
+             * @brief Creates an empty grid.
+             * @param cellSize The edge length of a cell. Query radii of about one cell perform best.
+             * @param bucketCount The number of buckets, rounded up to a power of two.
              */
-            template <typename TComponent>
-            auto& GetComponent(const EntityIndex entityIndex) noexcept
+            explicit SpatialGrid(const float cellSize, const std::size_t bucketCount = 65536)
+                : m_inverseCellSize{ 1.0f / cellSize }
             {
-                static_assert(Settings::template IsValidComponent<TComponent>(), "");
-
-                assert(HasComponent<TComponent>(entityIndex));
+                assert(cellSize > 0.0f);
 
-                auto& entity{ GetEntity(entityIndex) };
+                std::size_t powerOfTwo{ 1 };
+                while (powerOfTwo < bucketCount)
+                {
+                    powerOfTwo *= 2;
+                }
 
-                return m_componentStorage.template GetComponent<TComponent>(entity.dataIndex);
+                m_buckets.resize(powerOfTwo);
             }
 
             /**
-             * @brief Checks if a entity matches a signature using `bitwise and` operation.
-             * @tparam TSignature The signature type.
-             * @param entityIndex The entity index.
-             * @return bool
+             * @brief Brings the grid up to date with the manager. The manager's change version is advanced,
+             *        versions taken before remain valid for `ForEntitiesMatching<TSignature, Changed<T>>()`.
+             * @param manager The manager.
              */
-            template <typename TSignature>
-            auto MatchesSignature(const EntityIndex entityIndex) const noexcept
+            void Update(Manager<Settings>& manager)
             {
-                static_assert(Settings::template IsValidSignature<TSignature>(), "");
+                // only the indices whose position holder changed are touched, other structural changes are ignored
+                manager.template ForChangedHolders<TPosition>(m_changeVersion, [this](const EntityIndex entityIndex, const TPosition* position)
+                {
+                    if (position)
+                    {
+                        Move(entityIndex, position->x, position->y);
+                    }
+                    else
+                    {
+                        Remove(entityIndex);
+                    }
+                });
 
-                const auto& entityBitset{ GetEntity(entityIndex).bitset };
-                const auto& signatureBitset{ m_signatureBitsetsStorage.template GetSignatureBitset<TSignature>() };
+                manager.template ForChangedComponents<TPosition>(m_changeVersion, [this](const EntityIndex entityIndex, const TPosition& position)
+                {
+                    Move(entityIndex, position.x, position.y);
+                });
 
-                return (signatureBitset & entityBitset) == signatureBitset;
+                m_changeVersion = manager.AdvanceChangeVersion();
             }
 
             /**
-             * @brief Iterate over all alive entities.
+             * @brief Calls `callable(EntityIndex)` for every entity within `radius` of the point.
              * @tparam TCallable A callable type.
+             * @param x The x coordinate of the center.
+             * @param y The y coordinate of the center.
+             * @param radius The radius.
              * @param callable A Closure to pass.
              */
             template <typename TCallable>
-            void ForEntities(TCallable&& callable)
+            void ForEachInRadius(const float x, const float y, const float radius, TCallable&& callable) const
             {
-                for (EntityIndex index{ 0 }; index < m_size; ++index)
+                const auto radiusSquared{ radius * radius };
+
+                ForEachInCells(x - radius, y - radius, x + radius, y + radius, [x, y, radiusSquared, &callable](const Entry& entry)
                 {
-                    callable(index);
-                }
+                    const auto dx{ entry.x - x };
+                    const auto dy{ entry.y - y };
+
+                    if (dx * dx + dy * dy <= radiusSquared)
+                    {
+                        callable(entry.entityIndex);
+                    }
+                });
             }
 
             /**
-             * @brief Iterate over all alive entities matching a particular signature.
-             * @tparam TSignature The signature type.
+             * @brief Calls `callable(EntityIndex)` for every entity inside the axis-aligned box.
              * @tparam TCallable A callable type.
+             * @param minX The left edge.
+             * @param minY The bottom edge.
+             * @param maxX The right edge.
+             * @param maxY The top edge.
              * @param callable A Closure to pass.
              */
-            template <typename TSignature, typename TCallable>
-            void ForEntitiesMatching(TCallable&& callable)
+            template <typename TCallable>
+            void ForEachInBox(const float minX, const float minY, const float maxX, const float maxY, TCallable&& callable) const
             {
-                static_assert(Settings::template IsValidSignature<TSignature>(), "");
-
-                ForEntities
-                (
-                    [this, &callable](auto entityIndex)
+                ForEachInCells(minX, minY, maxX, maxY, [minX, minY, maxX, maxY, &callable](const Entry& entry)
+                {
+                    if (entry.x >= minX && entry.x <= maxX && entry.y >= minY && entry.y <= maxY)
                     {
-                        if (MatchesSignature<TSignature>(entityIndex))
-                        {
-                            this->template ExpandSignatureCall<TSignature>(entityIndex, callable);
-                        }
+                        callable(entry.entityIndex);
                     }
-                );
+                });
             }
 
             /**
-             * @brief Returns the number of alive entities.
-             * @return std::size_t
+             * @brief Collects the entities within `radius` of the point, e.g. for `ForEntitiesMatching(candidates, callable)`.
+             * @param x The x coordinate of the center.
+             * @param y The y coordinate of the center.
+             * @param radius The radius.
+             * @param result Cleared and filled with the entity indices.
              */
-            std::size_t GetEntityCount() const noexcept
+            void QueryRadius(const float x, const float y, const float radius, std::vector<EntityIndex>& result) const
             {
-                return m_size;
+                result.clear();
+                ForEachInRadius(x, y, radius, [&result](const EntityIndex entityIndex) { result.push_back(entityIndex); });
             }
 
             /**
-             * @brief Print the state of the entity metadata.
-             * @param oss std::ostream
+             * @brief Collects the entities inside the axis-aligned box, e.g. for `ForEntitiesMatching(candidates, callable)`.
+             * @param minX The left edge.
+             * @param minY The bottom edge.
+             * @param maxX The right edge.
+             * @param maxY The top edge.
+             * @param result Cleared and filled with the entity indices.
              */
-            void PrintState(std::ostream& oss) const
+            void QueryBox(const float minX, const float minY, const float maxX, const float maxY, std::vector<EntityIndex>& result) const
             {
-                oss << "\nsize: " << m_size
-                    << "\nsizeNext: " << m_sizeNext
-                    << "\ncapacity: " << m_capacity
-                    << "\n";
-
-                for (auto i{ 0u }; i < m_sizeNext; ++i)
-                {
-                    auto& e(m_entities[i]);
-                    oss << (e.alive ? "A" : "D");
-                }
+                result.clear();
+                ForEachInBox(minX, minY, maxX, maxY, [&result](const EntityIndex entityIndex) { result.push_back(entityIndex); });
+            }
 
-                oss << "\n\n";
+            /**
+             * @brief Returns the number of entities in the grid.
+             * @return std::size_t
+             */
+            std::size_t GetSize() const noexcept
+            {
+                return m_size;
             }
 
         protected:
 
         private:
             /**
-             * @brief Grow entity and component vectors.
-             * @param newCapacity The new capacity.
+             * @brief An entity with a copy of its position, so that queries stay inside the bucket.
              */
-            void GrowTo(std::size_t newCapacity)
+            struct Entry
             {
-                assert(newCapacity > m_capacity);
+                EntityIndex entityIndex;
+                float x;
+                float y;
+            };
 
-                m_entities.resize(newCapacity);
-                m_componentStorage.GrowTo(newCapacity);
+            /**
+             * @brief The place of an entity in `m_buckets`.
+             */
+            struct Location
+            {
+                std::uint32_t bucket;
+                std::uint32_t slot;
+            };
 
-                // initialize the the entities to default values
-                for (auto i{ m_capacity }; i < newCapacity; ++i)
-                {
-                    auto& entity{ m_entities[i] };
-                    entity.dataIndex = i;
-                    entity.bitset.reset();
-                    entity.alive = false;
-                }
+            static constexpr std::uint32_t NO_BUCKET{ ~std::uint32_t{ 0 } };
 
-                m_capacity = newCapacity;
-            }
+            float m_inverseCellSize;
+            std::vector<std::vector<Entry>> m_buckets;
+            std::vector<Location> m_locations;
+            std::size_t m_size{ 0 };
 
             /**
-             * @brief Run `GrowTo()` with a fixed value, if needed.
+             * @brief The manager's change version at the last `Update()`. `0` visits all entities.
              */
-            void GrowIfNeeded()
+            ChangeVersion m_changeVersion{ 0 };
+
+            /**
+             * @brief The largest cell coordinate. Keeps the cast defined and the cell loops from overflowing.
+             */
+            static constexpr std::int32_t MAX_CELL{ 1 << 30 };
+
+            std::int32_t GetCell(const float coordinate) const noexcept
             {
-                if (m_capacity > m_sizeNext)
+                const auto cell{ std::floor(coordinate * m_inverseCellSize) };
+
+                // NaN lands in the lowest cell
+                if (!(cell > -MAX_CELL))
                 {
-                    return;
+                    return -MAX_CELL;
                 }
 
-                // `GrowTo()` with fixed value
-                GrowTo((m_capacity + 10) * 2);
+                return cell < MAX_CELL ? static_cast<std::int32_t>(cell) : MAX_CELL;
             }
 
-            /**
-             * @brief Get entity by index.
-             * @param entityIndex The entity index.
-             * @return Reference to the entity.
-             */
-            auto& GetEntity(const EntityIndex entityIndex) noexcept
+            std::uint32_t GetBucket(const std::int32_t cellX, const std::int32_t cellY) const noexcept
             {
-                assert(m_sizeNext > entityIndex);
-                return m_entities[entityIndex];
-            }
+                const auto hash{ static_cast<std::uint32_t>(cellX) * 73856093u ^ static_cast<std::uint32_t>(cellY) * 19349663u };
 
-            /**
-             * @brief Get entity by index.
-             * @param entityIndex The entity index.
-             * @return Const reference to the entity.
-             */
-            const auto& GetEntity(const EntityIndex entityIndex) const noexcept
-            {
-                assert(m_sizeNext > entityIndex);
-                return m_entities[entityIndex];
+                return hash & static_cast<std::uint32_t>(m_buckets.size() - 1);
             }
 
             /**
-             * @brief Alive entities found on the right will be swapped with dead entities found on the left.
-             * @return The number of alive entities, which is one-past the index of the last alive entity.
+             * @brief Inserts an entity or moves it to the bucket of its new position.
+             * @param entityIndex The entity index.
+             * @param x The new x coordinate.
+             * @param y The new y coordinate.
              */
-            EntityIndex ArrangeAliveEntitiesToLeft() noexcept
+            void Move(const EntityIndex entityIndex, const float x, const float y)
             {
-                // The algorithm is implemented using two indices.
-                // * `iD` looks for dead entities, starting from the left.
-                // * `iA` looks for alive entities, starting from the right.
-
-                EntityIndex iD{ 0 }, iA{ m_sizeNext - 1 };
-
-                while (true)
+                if (entityIndex >= m_locations.size())
                 {
-                    // Find first dead entity from the left.
-                    for (; true; ++iD)
-                    {
-                        // We have to immediately check if we have gone
-                        // through the `iA` index. If that's the case, there
-                        // are no more dead entities in the vector and we can
-                        // return `iD` as our result.
-                        if (iD > iA) return iD;
-
-                        // If we found a dead entity, we break out of this
-                        // inner for-loop.
-                        if (!m_entities[iD].alive) break;
-                    }
-
-                    // Find first alive entity from the right.
-                    for (; true; --iA)
-                    {
-                        // In the case of alive entities, we have to perform
-                        // the checks done above in the reverse order.
-
-                        // If we found an alive entity, we immediately break
-                        // out of this inner for-loop.
-                        if (m_entities[iA].alive) break;
-
-                        // Otherwise, we acknowledge this is an entity that
-                        // has been killed since last refresh.
-                        // We will invalidate its handle here later.
-
-                        // If we reached `iD` or gone through it, we are
-                        // certain there are no more alive entities in the
-                        // entity metadata vector, and we can return `iD`.
-                        if (iA <= iD) return iD;
-                    }
-
-                    // If we arrived here, we have found two entities that
-                    // need to be swapped.
+                    m_locations.resize(std::max(entityIndex + 1, m_locations.size() * 2), Location{ NO_BUCKET, 0 });
+                }
 
-                    // `iA` points to an alive entity, towards the right of
-                    // the vector.
-                    assert(m_entities[iA].alive);
+                auto& location{ m_locations[entityIndex] };
+                const auto bucket{ GetBucket(GetCell(x), GetCell(y)) };
 
-                    // `iD` points to a dead entity, towards the left of the
-                    // vector.
-                    assert(!m_entities[iD].alive);
+                if (location.bucket == bucket)
+                {
+                    auto& entry{ m_buckets[bucket][location.slot] };
+                    entry.x = x;
+                    entry.y = y;
 
-                    // Therefore, we swap them to arrange all alive entities
-                    // towards the left.
-                    std::swap(m_entities[iA], m_entities[iD]);
+                    return;
+                }
 
-                    // After swapping, we will eventually need to refresh
-                    // the alive entity's handle and invalidate the dead
-                    // swapped entity's handle.
+                Remove(entityIndex);
 
-                    // Move both "iterator" indices.
-                    ++iD; --iA;
-                }
+                location.bucket = bucket;
+                location.slot = static_cast<std::uint32_t>(m_buckets[bucket].size());
+                m_buckets[bucket].push_back(Entry{ entityIndex, x, y });
+                ++m_size;
             }
 
             /**
-             * @brief Inner helper class. It contains a single static `call` function.
-             * @tparam TComponents A variadic number of component types.
+             * @brief Removes an entity, if it is in the grid.
+             * @param entityIndex The entity index.
              */
-            template <typename... TComponents>
-            struct ExpandCallHelper
+            void Remove(const EntityIndex entityIndex) noexcept
             {
-                /**
-                 * @brief Expand the component types into component references.
-                 * @tparam TCallable A callable type.
-                 * @param entityIndex The index of the entity.
-                 * @param manager A reference to the caller manager.
-                 * @param callable The function to call.
-                 */
-                template<typename TCallable>
-                static void Call(const EntityIndex entityIndex, ThisType& manager, TCallable&& callable)
+                if (entityIndex >= m_locations.size() || m_locations[entityIndex].bucket == NO_BUCKET)
                 {
-                    auto dataIndex{ manager.GetEntity(entityIndex).dataIndex };
-
-                    callable
-                    (
-                        entityIndex,
-                        manager.m_componentStorage.template GetComponent<TComponents>(dataIndex)...
-                    );
+                    return;
                 }
-            };
+
+                // swap-erase, the last entry of the old bucket takes the slot
+                auto& location{ m_locations[entityIndex] };
+                auto& entries{ m_buckets[location.bucket] };
+                entries[location.slot] = entries.back();
+                m_locations[entries[location.slot].entityIndex].slot = location.slot;
+                entries.pop_back();
+
+                location.bucket = NO_BUCKET;
+                --m_size;
+            }
 
             /**
-             * @brief Rename TypeList to `ExpandCallHelper`.
-             * @tparam TSignature A signature type.
-             * @tparam TCallable A callable type.
-             * @param entityIndex The entity index.
-             * @param callable A Closure.
+             * @brief Visits every entry of the cells overlapping the box. An entry is only visited for its own cell,
+             *        so cells sharing a bucket neither duplicate nor leak entries.
+             * @tparam TCallable A callable type: `void(const Entry& entry)`.
+             * @param minX The left edge.
+             * @param minY The bottom edge.
+             * @param maxX The right edge.
+             * @param maxY The top edge.
+             * @param callable The Closure.
              */
-            template <typename TSignature, typename TCallable>
-            void ExpandSignatureCall(const EntityIndex entityIndex, TCallable&& callable)
+            template <typename TCallable>
+            void ForEachInCells(const float minX, const float minY, const float maxX, const float maxY, TCallable&& callable) const
             {
-                static_assert(Settings::template IsValidSignature<TSignature>(), "");
+                const auto firstX{ GetCell(minX) };
+                const auto firstY{ GetCell(minY) };
+                const auto lastX{ GetCell(maxX) };
+                const auto lastY{ GetCell(maxY) };
+
+                // a box covering more cells than there are buckets is cheaper to answer with one pass over all entries
+                const auto cellCount{ (static_cast<double>(lastX) - firstX + 1) * (static_cast<double>(lastY) - firstY + 1) };
+                if (cellCount >= static_cast<double>(m_buckets.size()))
+                {
+                    for (const auto& entries : m_buckets)
+                    {
+                        for (const auto& entry : entries)
+                        {
+                            callable(entry);
+                        }
+                    }
 
-                using RequiredComponents = TSignature;
-                using Helper = typename Rename<RequiredComponents, ExpandCallHelper>::type;
+                    return;
+                }
 
-                Helper::Call(entityIndex, *this, callable);
+                for (auto cellY{ firstY }; cellY <= lastY; ++cellY)
+                {
+                    for (auto cellX{ firstX }; cellX <= lastX; ++cellX)
+                    {
+                        for (const auto& entry : m_buckets[GetBucket(cellX, cellY)])
+                        {
+                            if (GetCell(entry.x) == cellX && GetCell(entry.y) == cellY)
+                            {
+                                callable(entry);
+                            }
+                        }
+                    }
+                }
             }
         };
     }
@@ -1,6 +1,15 @@
+#include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
 #include "Ecs.hpp"
+#include "Benchmark.hpp"
 
 namespace sg
 {
@@ -164,14 +173,1955 @@ namespace sg
                     }
                 );
             }
+
+            void RunTimeTestsFreeList()
+            {
+                MyManager manager;
+                manager.SetRefreshMode(RefreshMode::FreeList);
+
+                for (auto index{ 0u }; index < 10; ++index)
+                {
+                    manager.AddComponent<HealthComponent>(manager.CreateIndex()).health = index;
+                }
+
+                manager.Refresh();
+                assert(manager.GetEntityCount() == 10);
+
+                // slots killed in this frame are not handed out again before the next refresh
+                manager.Kill(3);
+                manager.Kill(7);
+                manager.Kill(7);
+                assert(manager.GetEntityCount() == 10);
+
+                const auto appended{ manager.CreateIndex() };
+                assert(appended == 10);
+                assert(!manager.IsAlive(3) && !manager.IsAlive(7));
+
+                manager.Refresh();
+                assert(manager.GetEntityCount() == 9);
+
+                // afterwards they are reused without compaction
+                const auto reused0{ manager.CreateIndex() };
+                const auto reused1{ manager.CreateIndex() };
+                assert(reused0 == 7 && reused1 == 3);
+                assert(!manager.HasComponent<HealthComponent>(reused0));
+                assert(manager.GetEntityCount() == 9);
+
+                manager.Kill(5);
+                assert(manager.CreateIndex() == 11);
+                manager.Refresh();
+                assert(manager.GetEntityCount() == 11);
+
+                // the dead slot stays in place and is skipped
+                auto visited{ 0u };
+                manager.ForEntities([&manager, &visited](auto entityIndex)
+                {
+                    assert(manager.IsAlive(entityIndex));
+                    ++visited;
+                });
+                assert(visited == 11);
+
+                // switching back compacts the remaining dead slot
+                manager.SetRefreshMode(RefreshMode::SwapCompact);
+                assert(manager.GetEntityCount() == 11);
+                manager.ForEntities([&manager](auto entityIndex)
+                {
+                    assert(manager.IsAlive(entityIndex));
+                });
+            }
+
+            void RunTimeTestsRefresh()
+            {
+                MyManager manager;
+
+                // E0 - E4 survive a first refresh
+                for (auto index{ 0u }; index < 5; ++index)
+                {
+                    manager.AddComponent<HealthComponent>(manager.CreateIndex()).health = index;
+                }
+
+                manager.Refresh();
+
+                // E1 and E3 are killed, E5 - E7 are new
+                manager.Kill(1);
+                manager.Kill(3);
+
+                for (auto index{ 5u }; index < 8; ++index)
+                {
+                    manager.AddComponent<HealthComponent>(manager.CreateIndex()).health = index;
+                }
+
+                manager.Refresh();
+                assert(manager.GetEntityCount() == 6);
+
+                // same order as the two-pointer walk over all entities
+                const int expected[]{ 0, 7, 2, 6, 4, 5 };
+                manager.ForEntities([&manager, &expected](auto entityIndex)
+                {
+                    assert(manager.GetComponent<HealthComponent>(entityIndex).health == expected[entityIndex]);
+                });
+
+                // kill everything
+                for (auto index{ 0u }; index < 6; ++index)
+                {
+                    manager.Kill(index);
+                }
+
+                manager.Refresh();
+                assert(manager.GetEntityCount() == 0);
+            }
+
+            void RunTimeTestsCreateIndices()
+            {
+                MyManager manager;
+
+                // fragment the `DataIndex` order first
+                for (auto index{ 0u }; index < 50; ++index)
+                {
+                    manager.CreateIndex();
+                }
+
+                manager.Refresh();
+
+                for (auto index{ 0u }; index < 50; index += 3)
+                {
+                    manager.Kill(index);
+                }
+
+                manager.Refresh();
+
+                const auto first{ manager.CreateIndices(1000, HealthComponent{ 7 }, CircleComponent{ 2.0f }) };
+                assert(first == 33);
+
+                manager.Refresh();
+                assert(manager.GetEntityCount() == 1033);
+
+                auto count{ 0u };
+                manager.ForEntitiesMatching<SignatureLife>
+                (
+                    [&manager, &count](auto entityIndex, HealthComponent& healthComponent)
+                    {
+                        assert(healthComponent.health == 7);
+                        assert(manager.GetComponent<CircleComponent>(entityIndex).radius == 2.0f);
+                        assert(!manager.HasComponent<InputComponent>(entityIndex));
+                        ++count;
+                    }
+                );
+                assert(count == 1000);
+            }
+
+            // an executor as an application would provide it, the tasks are shared by four threads
+            struct FourThreadExecutor
+            {
+                template <typename TTask>
+                void operator()(const std::size_t taskCount, TTask&& task) const
+                {
+                    std::vector<std::thread> threads;
+
+                    for (std::size_t t{ 0 }; t < 4; ++t)
+                    {
+                        threads.emplace_back([taskCount, &task, t]()
+                        {
+                            for (auto taskIndex{ t }; taskIndex < taskCount; taskIndex += 4)
+                            {
+                                task(taskIndex);
+                            }
+                        });
+                    }
+
+                    for (auto& thread : threads)
+                    {
+                        thread.join();
+                    }
+                }
+            };
+
+            void RunTimeTestsKillMatching()
+            {
+                MyManager manager;
+
+                // several tasks per thread
+                const auto healthCount{ 9 * KILL_TASK_SIZE + 100 };
+                for (auto index{ 0u }; index < healthCount; ++index)
+                {
+                    manager.AddComponent<HealthComponent>(manager.CreateIndex()).health = index;
+                }
+
+                manager.CreateIndices(20, CircleComponent{ 1.0f }, InputComponent{ 1 });
+                manager.Refresh();
+
+                // entities created after the last refresh are not visited
+                for (auto index{ 0u }; index < 10; ++index)
+                {
+                    manager.AddComponent<HealthComponent>(manager.CreateIndex()).health = 1;
+                }
+
+                // odd health values die, marked by four threads
+                const auto killed
+                {
+                    manager.KillMatching<SignatureLife>
+                    (
+                        [](auto /*entityIndex*/, HealthComponent& healthComponent)
+                        {
+                            return healthComponent.health % 2 == 1;
+                        },
+                        FourThreadExecutor{}
+                    )
+                };
+                assert(killed == healthCount / 2);
+
+                manager.Refresh();
+                assert(manager.GetEntityCount() == healthCount / 2 + 30);
+
+                auto odd{ 0u };
+                manager.ForEntitiesMatching<SignatureLife>
+                (
+                    [&odd](auto /*entityIndex*/, HealthComponent& healthComponent)
+                    {
+                        odd += healthComponent.health % 2;
+                    }
+                );
+                assert(odd == 10);
+
+                // marked serially
+                assert(manager.KillMatching<SignatureLife>([](auto /*entityIndex*/, HealthComponent& healthComponent) { return healthComponent.health == 1; }) == 10);
+                assert(manager.KillAll<SignatureVelocity>() == 20);
+                assert(manager.KillAll<SignatureVelocity>() == 0);
+
+                manager.Refresh();
+                assert(manager.GetEntityCount() == healthCount / 2);
+            }
+
+            void RunTimeTestsCompactComponents()
+            {
+                MyManager manager;
+
+                for (auto frame{ 0u }; frame < 10; ++frame)
+                {
+                    for (auto index{ 0u }; index < 20; ++index)
+                    {
+                        manager.AddComponent<HealthComponent>(manager.CreateIndex()).health = frame * 100 + index;
+                    }
+
+                    for (auto index{ frame }; index < manager.GetEntityCount(); index += 4)
+                    {
+                        manager.Kill(index);
+                    }
+
+                    manager.Refresh();
+                }
+
+                assert(manager.GetFragmentation() > 0.0f);
+
+                auto sum{ 0 };
+                manager.ForEntitiesMatching<SignatureLife>
+                (
+                    [&sum](auto /*entityIndex*/, HealthComponent& healthComponent)
+                    {
+                        sum += healthComponent.health;
+                    }
+                );
+
+                manager.CompactComponents();
+                assert(manager.GetFragmentation() == 0.0f);
+
+                // entity order equals memory order and no component got lost
+                const auto* base{ &manager.GetComponent<HealthComponent>(0) };
+                auto sumAfter{ 0 };
+                manager.ForEntitiesMatching<SignatureLife>
+                (
+                    [base, &sumAfter](auto entityIndex, HealthComponent& healthComponent)
+                    {
+                        assert(&healthComponent == base + entityIndex);
+                        sumAfter += healthComponent.health;
+                    }
+                );
+                assert(sum == sumAfter);
+
+                // compaction by threshold
+                manager.SetCompactionThreshold(0.01f);
+                manager.Kill(0);
+                manager.Refresh();
+                assert(manager.GetFragmentation() == 0.0f);
+            }
+
+            void RunTimeTestsStableRefresh()
+            {
+                MyManager manager;
+                manager.SetRefreshMode(RefreshMode::StableCompact);
+
+                for (auto index{ 0u }; index < 5; ++index)
+                {
+                    manager.AddComponent<HealthComponent>(manager.CreateIndex()).health = index;
+                }
+
+                manager.Refresh();
+
+                manager.Kill(1);
+                manager.Kill(3);
+
+                for (auto index{ 5u }; index < 8; ++index)
+                {
+                    manager.AddComponent<HealthComponent>(manager.CreateIndex()).health = index;
+                }
+
+                manager.Kill(6);
+                manager.Refresh();
+                assert(manager.GetEntityCount() == 5);
+
+                // the survivors keep their creation order
+                const int expected[]{ 0, 2, 4, 5, 7 };
+                manager.ForEntities([&manager, &expected](auto entityIndex)
+                {
+                    assert(manager.GetComponent<HealthComponent>(entityIndex).health == expected[entityIndex]);
+                });
+            }
+
+            void RunTimeTestsPrefab()
+            {
+                MyManager manager;
+
+                Prefab<MySettings> bullet;
+                bullet.Set<HealthComponent>().health = 1;
+                bullet.Set<InputComponent>(InputComponent{ 5 });
+                bullet.Set<CircleComponent>().radius = 3.0f;
+                bullet.Remove<InputComponent>();
+
+                assert(bullet.Has<HealthComponent>());
+                assert(!bullet.Has<InputComponent>());
+
+                manager.CreateIndex();
+                const auto first{ manager.Instantiate(bullet, 500) };
+                assert(first == 1);
+
+                manager.Refresh();
+                assert(manager.GetEntityCount() == 501);
+
+                for (auto index{ first }; index < first + 500; ++index)
+                {
+                    assert(manager.GetComponent<HealthComponent>(index).health == 1);
+                    assert(manager.GetComponent<CircleComponent>(index).radius == 3.0f);
+                    assert(!manager.HasComponent<InputComponent>(index));
+                }
+            }
+
+            void RunTimeTestsClone()
+            {
+                MyManager manager;
+
+                const auto i0{ manager.CreateIndex() };
+                manager.AddComponent<HealthComponent>(i0).health = 42;
+                manager.AddComponent<InputComponent>(i0).key = 7;
+
+                const auto i1{ manager.CreateIndex() };
+                manager.AddComponent<CircleComponent>(i1).radius = 4.0f;
+
+                // enough copies to grow the storage
+                const auto first{ manager.Clone(i0, 300) };
+                assert(first == 2);
+
+                for (auto index{ first }; index < first + 300; ++index)
+                {
+                    assert(manager.GetComponent<HealthComponent>(index).health == 42);
+                    assert(manager.GetComponent<InputComponent>(index).key == 7);
+                    assert(!manager.HasComponent<CircleComponent>(index));
+                }
+
+                const std::vector<EntityIndex> sources{ i1, i0, i1 };
+                const auto firstCopy{ manager.CloneRange(sources) };
+
+                assert(manager.GetComponent<CircleComponent>(firstCopy).radius == 4.0f);
+                assert(!manager.HasComponent<HealthComponent>(firstCopy));
+                assert(manager.GetComponent<HealthComponent>(firstCopy + 1).health == 42);
+                assert(manager.GetComponent<CircleComponent>(firstCopy + 2).radius == 4.0f);
+
+                manager.Refresh();
+                assert(manager.GetEntityCount() == 305);
+            }
+
+            void RunTimeTestsMoveEntities()
+            {
+                MyManager west;
+                MyManager east;
+
+                for (auto index{ 0u }; index < 10; ++index)
+                {
+                    const auto entity{ west.CreateIndex() };
+                    west.AddComponent<HealthComponent>(entity).health = index;
+
+                    if (index % 2 == 0)
+                    {
+                        west.AddComponent<CircleComponent>(entity).radius = static_cast<float>(index);
+                    }
+                }
+
+                east.CreateIndex();
+
+                west.Refresh();
+                east.Refresh();
+
+                const std::vector<EntityIndex> leaving{ 2, 3, 8 };
+                const auto first{ MoveEntities(west, Span<const EntityIndex>(leaving), east) };
+                assert(first == 1);
+
+                west.Refresh();
+                east.Refresh();
+
+                assert(west.GetEntityCount() == 7);
+                assert(east.GetEntityCount() == 4);
+
+                assert(east.GetComponent<HealthComponent>(1).health == 2);
+                assert(east.GetComponent<CircleComponent>(1).radius == 2.0f);
+                assert(east.GetComponent<HealthComponent>(2).health == 3);
+                assert(!east.HasComponent<CircleComponent>(2));
+                assert(east.GetComponent<HealthComponent>(3).health == 8);
+
+                west.ForEntitiesMatching<SignatureLife>
+                (
+                    [](auto /*entityIndex*/, HealthComponent& healthComponent)
+                    {
+                        assert(healthComponent.health != 2 && healthComponent.health != 3 && healthComponent.health != 8);
+                    }
+                );
+            }
+
+            void RunTimeTestsCommandBuffers()
+            {
+                MyManager manager;
+
+                for (auto index{ 0u }; index < 4; ++index)
+                {
+                    manager.AddComponent<HealthComponent>(manager.CreateIndex()).health = index;
+                }
+
+                manager.Refresh();
+
+                // buffers are recorded in parallel, one per thread, listed out of order
+                std::vector<CommandBuffer<MySettings>> buffers;
+                buffers.emplace_back(1);
+                buffers.emplace_back(0);
+
+                std::thread worker0([&buffers]()
+                {
+                    auto& buffer{ buffers[1] };
+                    const auto entity{ buffer.CreateIndex() };
+                    buffer.AddComponent<HealthComponent>(entity, HealthComponent{ 100 });
+                    buffer.AddComponent<InputComponent>(entity);
+                    buffer.Kill(0);
+                });
+
+                std::thread worker1([&buffers]()
+                {
+                    auto& buffer{ buffers[0] };
+                    for (auto index{ 0u }; index < 200; ++index)
+                    {
+                        const auto entity{ buffer.CreateIndex() };
+                        buffer.AddComponent<CircleComponent>(entity, CircleComponent{ 1.0f });
+                    }
+                    buffer.DeleteComponent<HealthComponent>(1);
+                });
+
+                worker0.join();
+                worker1.join();
+
+                manager.ApplyCommandBuffers(buffers);
+                assert(buffers[0].GetCreateCount() == 0 && buffers[1].GetCreateCount() == 0);
+
+                // thread 0 is applied first, so its entity gets the first free index
+                assert(manager.GetComponent<HealthComponent>(4).health == 100);
+                assert(manager.HasComponent<InputComponent>(4));
+                assert(manager.GetComponent<CircleComponent>(5).radius == 1.0f);
+                assert(!manager.HasComponent<HealthComponent>(1));
+
+                manager.Refresh();
+                assert(manager.GetEntityCount() == 204);
+            }
+
+            void RunTimeTestsMatchBlocks()
+            {
+                MyManager manager;
+
+                // spans several match blocks and leaves an unaligned tail
+                for (auto index{ 0u }; index < 2500; ++index)
+                {
+                    const auto entity{ manager.CreateIndex() };
+
+                    if (index % 3 == 0) manager.AddComponent<CircleComponent>(entity);
+                    if (index % 5 == 0) manager.AddComponent<InputComponent>(entity);
+                    if (index % 7 == 0) manager.AddComponent<HealthComponent>(entity);
+                }
+
+                manager.Refresh();
+
+                auto expected{ 0u };
+                manager.ForEntities([&manager, &expected](auto entityIndex)
+                {
+                    if (manager.MatchesSignature<SignatureVelocity>(entityIndex))
+                    {
+                        ++expected;
+                    }
+                });
+                assert(expected == 167);
+
+                assert(manager.GetScanMode() == ScanMode::PerEntity);
+
+                for (const auto scanMode : { ScanMode::PerEntity, ScanMode::Blocks })
+                {
+                    manager.SetScanMode(scanMode);
+
+                    auto visited{ 0u };
+                    EntityIndex previous{ 0 };
+                    manager.ForEntitiesMatching<SignatureVelocity>
+                    (
+                        [&manager, &visited, &previous](auto entityIndex, InputComponent& /*inputComponent*/, CircleComponent& /*circleComponent*/)
+                        {
+                            assert(manager.MatchesSignature<SignatureVelocity>(entityIndex));
+                            assert(visited == 0 || entityIndex > previous);
+                            previous = entityIndex;
+                            ++visited;
+                        }
+                    );
+                    assert(visited == expected);
+                }
+            }
+
+            // circles without input, with an optional health component
+            using SignatureFreeCircle = Signature<CircleComponent, Without<InputComponent>, Optional<HealthComponent>>;
+            using TermSettings = Settings<MyComponentsList, SignatureList<SignatureVelocity, SignatureFreeCircle>>;
+
+            void RunTimeTestsSignatureTerms()
+            {
+                Manager<TermSettings> manager;
+
+                for (auto index{ 0u }; index < 30; ++index)
+                {
+                    const auto entity{ manager.CreateIndex() };
+                    manager.AddComponent<CircleComponent>(entity).radius = static_cast<float>(index);
+
+                    if (index % 3 == 0) manager.AddComponent<InputComponent>(entity);
+                    if (index % 2 == 0) manager.AddComponent<HealthComponent>(entity).health = index;
+                }
+
+                manager.Refresh();
+
+                auto visited{ 0u };
+                auto withHealth{ 0u };
+                manager.ForEntitiesMatching<SignatureFreeCircle>
+                (
+                    [&manager, &visited, &withHealth](auto entityIndex, HealthComponent* healthComponent, CircleComponent& circleComponent)
+                    {
+                        assert(!manager.HasComponent<InputComponent>(entityIndex));
+                        assert(manager.MatchesSignature<SignatureFreeCircle>(entityIndex));
+                        assert((healthComponent != nullptr) == manager.HasComponent<HealthComponent>(entityIndex));
+
+                        if (healthComponent)
+                        {
+                            assert(healthComponent->health == static_cast<int>(circleComponent.radius));
+                            ++withHealth;
+                        }
+
+                        ++visited;
+                    }
+                );
+
+                assert(visited == 20);
+                assert(withHealth == 10);
+                assert(manager.KillAll<SignatureFreeCircle>() == 20);
+            }
+
+            void RunTimeTestsView()
+            {
+                MyManager manager;
+
+                for (auto index{ 0u }; index < 100; ++index)
+                {
+                    const auto entity{ manager.CreateIndex() };
+                    manager.AddComponent<InputComponent>(entity).key = index;
+
+                    if (index % 2 == 0)
+                    {
+                        manager.AddComponent<CircleComponent>(entity).radius = static_cast<float>(index);
+                    }
+                }
+
+                manager.Refresh();
+
+                auto view{ manager.View<SignatureVelocity>() };
+                assert(view.size() == 50);
+                assert(view.end() - view.begin() == 50);
+
+                // elements are (entityIndex, components...) like the callback parameters
+                std::for_each(view.begin(), view.end(), [](auto element)
+                {
+                    std::get<2>(element).radius += 1.0f;
+                });
+
+                for (auto element : view)
+                {
+                    const auto entityIndex{ std::get<0>(element) };
+                    const InputComponent& inputComponent{ std::get<1>(element) };
+                    const CircleComponent& circleComponent{ std::get<2>(element) };
+
+                    assert(inputComponent.key % 2 == 0);
+                    assert(circleComponent.radius == static_cast<float>(inputComponent.key) + 1.0f);
+                    assert(&circleComponent == &manager.GetComponent<CircleComponent>(entityIndex));
+                }
+
+                // early exit and random access
+                const auto found{ std::find_if(view.begin(), view.end(), [](auto element)
+                {
+                    return std::get<1>(element).key == 42;
+                }) };
+                assert(found != view.end());
+                assert(found - view.begin() == 21);
+                assert(std::get<1>(view[21]).key == 42);
+
+                // a second view shares the cached matches until the structure changes
+                const auto again{ manager.View<SignatureVelocity>() };
+                assert(again.begin() == view.begin());
+
+                manager.Kill(std::get<0>(view[0]));
+                manager.Refresh();
+                const auto changed{ manager.View<SignatureVelocity>() };
+                assert(changed.size() == 49);
+                assert(std::get<1>(changed[0]).key == 2);
+
+                // the iterators are random access with a tuple of references, so the work can be split between threads
+                using Iterator = decltype(changed.begin());
+                static_assert(std::is_same<std::iterator_traits<Iterator>::iterator_category, std::random_access_iterator_tag>::value, "");
+                static_assert(std::is_same<std::iterator_traits<Iterator>::reference, std::tuple<EntityIndex, InputComponent&, CircleComponent&>>::value, "");
+                static_assert(std::is_same<std::iterator_traits<Iterator>::value_type, std::tuple<EntityIndex, InputComponent, CircleComponent>>::value, "");
+
+                std::vector<std::thread> threads;
+                const auto share{ (changed.size() + 3) / 4 };
+
+                for (std::size_t t{ 0 }; t < 4; ++t)
+                {
+                    const auto first{ changed.begin() + static_cast<std::ptrdiff_t>(std::min(t * share, changed.size())) };
+                    const auto last{ changed.begin() + static_cast<std::ptrdiff_t>(std::min((t + 1) * share, changed.size())) };
+
+                    threads.emplace_back([first, last]()
+                    {
+                        std::for_each(first, last, [](auto element) { std::get<2>(element).radius = 7.0f; });
+                    });
+                }
+
+                for (auto& thread : threads)
+                {
+                    thread.join();
+                }
+
+                for (const auto element : changed)
+                {
+                    assert(std::get<2>(element).radius == 7.0f);
+                }
+            }
+
+            void RunTimeTestsForEachChunk()
+            {
+                MyManager manager;
+                manager.CreateIndices(3000, CircleComponent{ 1.0f }, InputComponent{ 2 });
+                manager.CreateIndices(10, HealthComponent{});
+                manager.Refresh();
+
+                // fresh entities are stored in order, so all matches form one chunk
+                auto chunks{ 0u };
+                auto visited{ 0u };
+                manager.ForEachChunk<SignatureVelocity>
+                (
+                    [&chunks, &visited](Span<const EntityIndex> entityIndices, Span<InputComponent> inputComponents, Span<CircleComponent> circleComponents)
+                    {
+                        assert(entityIndices.size() == inputComponents.size() && entityIndices.size() == circleComponents.size());
+
+                        for (std::size_t i{ 0 }; i < circleComponents.size(); ++i)
+                        {
+                            circleComponents[i].radius += static_cast<float>(inputComponents[i].key);
+                        }
+
+                        ++chunks;
+                        visited += static_cast<unsigned>(entityIndices.size());
+                    }
+                );
+                assert(chunks == 1);
+                assert(visited == 3000);
+
+                // fragment the storage, every component is still visited once
+                for (EntityIndex index{ 0 }; index < 3000; index += 2)
+                {
+                    manager.Kill(index);
+                }
+
+                manager.Refresh();
+                manager.CreateIndices(500, CircleComponent{ 1.0f }, InputComponent{ 2 });
+                manager.Refresh();
+
+                auto sum{ 0.0f };
+                visited = 0;
+                manager.ForEachChunk<SignatureVelocity>
+                (
+                    [&manager, &sum, &visited](Span<const EntityIndex> entityIndices, Span<InputComponent>, Span<CircleComponent> circleComponents)
+                    {
+                        for (std::size_t i{ 0 }; i < circleComponents.size(); ++i)
+                        {
+                            assert(&circleComponents[i] == &manager.GetComponent<CircleComponent>(entityIndices[i]));
+                            sum += circleComponents[i].radius;
+                        }
+
+                        visited += static_cast<unsigned>(entityIndices.size());
+                    }
+                );
+                assert(visited == 2000);
+                assert(sum == 1500 * 3.0f + 500 * 1.0f);
+
+                // after compaction, only entities which do not match split the chunks
+                manager.CompactComponents();
+                manager.Kill(100);
+                manager.DeleteComponent<InputComponent>(1000);
+
+                chunks = 0;
+                visited = 0;
+                EntityIndex previousEnd{ 0 };
+                manager.ForEachChunk<SignatureVelocity>
+                (
+                    [&manager, &chunks, &visited, &previousEnd](Span<const EntityIndex> entityIndices, Span<InputComponent>, Span<CircleComponent> circleComponents)
+                    {
+                        // chunks are maximal: the entity after the previous chunk does not match
+                        assert(chunks == 0 || entityIndices[0] > previousEnd);
+                        assert(chunks == 0 || !manager.IsAlive(previousEnd) || !manager.MatchesSignature<SignatureVelocity>(previousEnd));
+
+                        for (std::size_t i{ 0 }; i < entityIndices.size(); ++i)
+                        {
+                            assert(&circleComponents[i] == &manager.GetComponent<CircleComponent>(entityIndices[i]));
+                            assert(manager.IsAlive(entityIndices[i]) && entityIndices[i] == entityIndices[0] + i);
+                        }
+
+                        ++chunks;
+                        previousEnd = entityIndices[0] + static_cast<EntityIndex>(entityIndices.size());
+                        visited += static_cast<unsigned>(entityIndices.size());
+                    }
+                );
+                assert(visited == 1998);
+            }
+
+            void RunTimeTestsPrefetch()
+            {
+                Manager<TermSettings> manager;
+                manager.SetPrefetchDistance(8);
+                assert(manager.GetPrefetchDistance() == 8);
+
+                manager.CreateIndices(1500, CircleComponent{ 1.0f });
+                manager.CreateIndices(500, CircleComponent{ 1.0f }, HealthComponent{ 3 });
+                manager.CreateIndices(5, CircleComponent{ 1.0f }, InputComponent{});
+                manager.Refresh();
+
+                for (const auto scanMode : { ScanMode::PerEntity, ScanMode::Blocks })
+                {
+                    manager.SetScanMode(scanMode);
+
+                    // every match is visited once, also across block ends and for short blocks
+                    for (const auto distance : { 8u, 1000u })
+                    {
+                        manager.SetPrefetchDistance(distance);
+
+                        auto visited{ 0u };
+                        auto healthy{ 0u };
+                        manager.ForEntitiesMatching<SignatureFreeCircle>
+                        (
+                            [&visited, &healthy](auto /*entityIndex*/, HealthComponent* healthComponent, CircleComponent& circleComponent)
+                            {
+                                assert(circleComponent.radius == 1.0f);
+                                healthy += healthComponent != nullptr;
+                                ++visited;
+                            }
+                        );
+                        assert(visited == 2000);
+                        assert(healthy == 500);
+                    }
+
+                    auto visited{ 0u };
+                    manager.SetPrefetchDistance(5000);
+                    manager.ForEntitiesMatching<SignatureVelocity>
+                    (
+                        [&visited](auto /*entityIndex*/, InputComponent& /*inputComponent*/, CircleComponent& /*circleComponent*/)
+                        {
+                            ++visited;
+                        }
+                    );
+                    assert(visited == 5);
+                }
+            }
+
+            void RunTimeTestsQuery()
+            {
+                MyManager manager;
+                manager.CreateIndices(100, CircleComponent{ 1.0f }, InputComponent{ 2 });
+                manager.CreateIndices(50, CircleComponent{ 3.0f });
+                manager.CreateIndices(25, InputComponent{ 4 });
+                manager.Kill(0);
+                manager.Refresh();
+
+                assert(MySettings::GetComponentSize(MySettings::GetComponentId<CircleComponent>()) == sizeof(CircleComponent));
+
+                // the pointers follow the order of the `Require()` calls
+                Query<MySettings> query;
+                query.Require(MySettings::GetComponentId<InputComponent>()).Require(MySettings::GetComponentId<CircleComponent>());
+
+                auto visited{ 0u };
+                manager.ForEntitiesMatching(query, [&manager, &visited](auto entityIndex, void* const* components)
+                {
+                    assert(components[0] == &manager.GetComponent<InputComponent>(entityIndex));
+                    assert(static_cast<CircleComponent*>(components[1])->radius == 1.0f);
+                    ++visited;
+                });
+                assert(visited == 99);
+
+                Query<MySettings> circlesOnly;
+                circlesOnly.Require(MySettings::GetComponentId<CircleComponent>()).Exclude(MySettings::GetComponentId<InputComponent>());
+
+                auto sum{ 0.0f };
+                manager.ForEntitiesMatching(circlesOnly, [&sum](auto /*entityIndex*/, void* const* components)
+                {
+                    sum += static_cast<CircleComponent*>(components[0])->radius;
+                });
+                assert(sum == 150.0f);
+
+                // an empty query matches every alive entity
+                visited = 0;
+                manager.ForEntitiesMatching(Query<MySettings>(), [&visited](auto /*entityIndex*/, void* const* /*components*/)
+                {
+                    ++visited;
+                });
+                assert(visited == manager.GetEntityCount());
+            }
+
+            using SignatureCircle = Signature<CircleComponent>;
+            using GroupSettings = Settings<MyComponentsList, SignatureList<SignatureVelocity, SignatureCircle>>;
+
+            template <typename TManager>
+            void CheckGroups(TManager& manager)
+            {
+                auto circles{ 0u };
+                auto velocities{ 0u };
+
+                manager.ForEntities([&](auto entityIndex)
+                {
+                    if (!manager.template HasComponent<CircleComponent>(entityIndex))
+                    {
+                        return;
+                    }
+
+                    // the components of an entity move together
+                    assert(manager.template GetComponent<CircleComponent>(entityIndex).radius == static_cast<float>(manager.template GetComponent<HealthComponent>(entityIndex).health));
+                    ++circles;
+                    velocities += manager.template HasComponent<InputComponent>(entityIndex);
+                });
+
+                assert(manager.template GetGroupSize<SignatureCircle>() == circles);
+                assert(manager.template GetGroupSize<SignatureVelocity>() == velocities);
+
+                // the inner group is a prefix of the outer group
+                auto visited{ 0u };
+                manager.template ForEntitiesInGroup<SignatureVelocity>([&](auto entityIndex, InputComponent&, CircleComponent& circleComponent)
+                {
+                    assert(&circleComponent == &manager.template GetComponent<CircleComponent>(entityIndex));
+                    assert(manager.template MatchesSignature<SignatureVelocity>(entityIndex));
+                    ++visited;
+                });
+                assert(visited == velocities);
+
+                visited = 0;
+                manager.template ForEntitiesInGroup<SignatureCircle>([&](auto entityIndex, CircleComponent& circleComponent)
+                {
+                    assert(&circleComponent == &manager.template GetComponent<CircleComponent>(entityIndex));
+                    assert(manager.IsAlive(entityIndex));
+                    assert((visited < velocities) == manager.template HasComponent<InputComponent>(entityIndex));
+                    ++visited;
+                });
+                assert(visited == circles);
+            }
+
+            void RunTimeTestsGroups()
+            {
+                for (const auto refreshMode : { RefreshMode::SwapCompact, RefreshMode::StableCompact, RefreshMode::FreeList })
+                {
+                    Manager<GroupSettings> manager;
+                    manager.SetRefreshMode(refreshMode);
+
+                    auto nextId{ 0 };
+                    const auto create = [&manager, &nextId](const bool circle, const bool input)
+                    {
+                        const auto entityIndex{ manager.CreateIndex() };
+                        manager.template AddComponent<HealthComponent>(entityIndex).health = nextId;
+
+                        if (circle)
+                        {
+                            manager.template AddComponent<CircleComponent>(entityIndex).radius = static_cast<float>(nextId);
+                        }
+
+                        if (input)
+                        {
+                            manager.template AddComponent<InputComponent>(entityIndex);
+                        }
+
+                        ++nextId;
+                    };
+
+                    for (auto i{ 0 }; i < 60; ++i)
+                    {
+                        create(i % 2 == 0, i % 3 == 0);
+                    }
+
+                    manager.Refresh();
+
+                    // groups added to a populated manager, the inner one first
+                    manager.AddGroup<SignatureVelocity>();
+                    manager.AddGroup<SignatureCircle>();
+                    CheckGroups(manager);
+
+                    for (auto round{ 0 }; round < 20; ++round)
+                    {
+                        for (EntityIndex entityIndex{ 0 }; entityIndex < manager.GetEntityCount(); ++entityIndex)
+                        {
+                            if (!manager.IsAlive(entityIndex))
+                            {
+                                continue;
+                            }
+
+                            const auto roll{ (entityIndex * 7 + round * 13) % 11 };
+                            if (roll == 0)
+                            {
+                                manager.Kill(entityIndex);
+                            }
+                            else if (roll == 1 && manager.HasComponent<InputComponent>(entityIndex))
+                            {
+                                manager.DeleteComponent<InputComponent>(entityIndex);
+                            }
+                            else if (roll == 2 && !manager.HasComponent<CircleComponent>(entityIndex))
+                            {
+                                manager.AddComponent<CircleComponent>(entityIndex).radius = static_cast<float>(manager.GetComponent<HealthComponent>(entityIndex).health);
+                            }
+                            else if (roll == 3 && manager.HasComponent<CircleComponent>(entityIndex))
+                            {
+                                manager.AddComponent<InputComponent>(entityIndex);
+                            }
+                        }
+
+                        create(true, round % 2 == 0);
+                        create(round % 3 == 0, true);
+                        manager.Refresh();
+                        CheckGroups(manager);
+                    }
+
+                    // bulk creation enters the groups as well
+                    Prefab<GroupSettings> prefab;
+                    prefab.Set<HealthComponent>().health = 7;
+                    prefab.Set<CircleComponent>().radius = 7.0f;
+                    prefab.Set<InputComponent>();
+                    manager.Instantiate(prefab, 30);
+                    manager.Refresh();
+                    CheckGroups(manager);
+
+                    manager.KillAll<SignatureVelocity>();
+                    manager.Refresh();
+                    assert(manager.GetGroupSize<SignatureVelocity>() == 0);
+                    CheckGroups(manager);
+
+                    // slots are never reordered while groups exist: no automatic compaction, the explicit calls throw
+                    manager.Instantiate(prefab, 30);
+                    manager.Refresh();
+                    manager.SetCompactionInterval(1);
+                    manager.SetCompactionThreshold(0.01f);
+
+                    const auto killFirstAlive = [&manager]()
+                    {
+                        EntityIndex entityIndex{ 0 };
+                        while (!manager.IsAlive(entityIndex))
+                        {
+                            ++entityIndex;
+                        }
+
+                        manager.Kill(entityIndex);
+                        return entityIndex;
+                    };
+
+                    killFirstAlive();
+                    manager.Refresh();
+                    CheckGroups(manager);
+
+                    auto rejected{ 0 };
+                    const auto expectRejected = [&rejected](auto&& call)
+                    {
+                        try
+                        {
+                            call();
+                        }
+                        catch (const std::invalid_argument&)
+                        {
+                            ++rejected;
+                        }
+                    };
+
+                    const auto killed{ killFirstAlive() };
+                    expectRejected([&manager]() { manager.CompactComponents(); });
+                    expectRejected([&manager]() { manager.SortBy<HealthComponent>([](const HealthComponent& lhs, const HealthComponent& rhs) { return lhs.health < rhs.health; }); });
+                    assert(rejected == 2);
+                    assert(!manager.IsAlive(killed));
+                    manager.Refresh();
+                    CheckGroups(manager);
+                }
+            }
+
+            void RunTimeTestsSortBy()
+            {
+                for (const auto refreshMode : { RefreshMode::SwapCompact, RefreshMode::FreeList })
+                {
+                    MyManager manager;
+                    manager.SetRefreshMode(refreshMode);
+
+                    for (auto i{ 0 }; i < 200; ++i)
+                    {
+                        const auto entityIndex{ manager.CreateIndex() };
+                        const auto key{ (i * 37) % 200 };
+                        manager.AddComponent<HealthComponent>(entityIndex).health = key;
+
+                        if (i % 5 != 0)
+                        {
+                            manager.AddComponent<CircleComponent>(entityIndex).radius = static_cast<float>(key);
+                        }
+                    }
+
+                    manager.Refresh();
+                    for (EntityIndex entityIndex{ 0 }; entityIndex < 200; entityIndex += 7)
+                    {
+                        manager.Kill(entityIndex);
+                    }
+
+                    const auto byRadius = [](const CircleComponent& lhs, const CircleComponent& rhs)
+                    {
+                        return lhs.radius < rhs.radius;
+                    };
+
+                    const auto check = [&manager]()
+                    {
+                        auto previous{ -1.0f };
+                        auto sorted{ true };
+                        auto circles{ 0u };
+
+                        manager.ForEntities([&](auto entityIndex)
+                        {
+                            // the component data follows the new order
+                            assert(&manager.GetComponent<HealthComponent>(entityIndex) == &manager.GetComponent<HealthComponent>(0) + entityIndex);
+
+                            if (!manager.HasComponent<CircleComponent>(entityIndex))
+                            {
+                                sorted = false;
+                                return;
+                            }
+
+                            const auto radius{ manager.GetComponent<CircleComponent>(entityIndex).radius };
+                            assert(sorted && radius >= previous);
+                            assert(radius == static_cast<float>(manager.GetComponent<HealthComponent>(entityIndex).health));
+                            previous = radius;
+                            ++circles;
+                        });
+
+                        return circles;
+                    };
+
+                    manager.SortBy<CircleComponent>(byRadius);
+                    const auto circles{ check() };
+                    assert(manager.GetFragmentation() == 0.0f);
+
+                    // nearly sorted data
+                    manager.GetComponent<CircleComponent>(3).radius = 1000.0f;
+                    manager.GetComponent<HealthComponent>(3).health = 1000;
+                    manager.SortBy<CircleComponent>(byRadius, SortMode::Insertion);
+                    assert(check() == circles);
+                    assert(manager.GetComponent<CircleComponent>(circles - 1).radius == 1000.0f);
+
+                    // killed slots are reused after sorting
+                    const auto count{ manager.GetEntityCount() };
+                    manager.CreateIndex();
+                    manager.Refresh();
+                    assert(manager.GetEntityCount() == count + 1);
+                }
+            }
+
+            using SignatureReadInput = Signature<CircleComponent, Read<InputComponent>>;
+            using ChangeSettings = Settings<MyComponentsList, SignatureList<SignatureVelocity, SignatureReadInput>>;
+
+            void RunTimeTestsChangeVersions()
+            {
+                Manager<ChangeSettings> manager;
+                manager.CreateIndices(1000, CircleComponent{ 1.0f }, InputComponent{ 2 });
+                manager.Refresh();
+
+                const auto countChanged = [&manager](const ChangeVersion sinceVersion)
+                {
+                    auto changed{ 0u };
+                    manager.ForEntitiesMatching<SignatureVelocity, Changed<InputComponent>>(sinceVersion, [&changed](auto /*entityIndex*/, InputComponent&, CircleComponent&)
+                    {
+                        ++changed;
+                    });
+
+                    return changed;
+                };
+
+                // created components count as written
+                assert(countChanged(0) == 1000);
+
+                auto seen{ manager.AdvanceChangeVersion() };
+                assert(manager.GetChangeVersion() == seen + 1);
+                assert(countChanged(seen) == 0);
+
+                // only the written components are visited
+                manager.GetComponent<InputComponent>(10).key = 5;
+                manager.GetComponent<InputComponent>(700).key = 5;
+                manager.AddComponent<InputComponent>(999).key = 5;
+                manager.GetComponent<CircleComponent>(500).radius = 3.0f;
+                assert(countChanged(seen) == 3);
+
+                // read-only parameters do not count as writes, the others do
+                seen = manager.AdvanceChangeVersion();
+                auto keys{ 0 };
+                manager.ForEntitiesMatching<SignatureReadInput>([&keys](auto /*entityIndex*/, const InputComponent& inputComponent, CircleComponent&)
+                {
+                    keys += inputComponent.key;
+                });
+                assert(keys == 997 * 2 + 3 * 5);
+                assert(countChanged(seen) == 0);
+
+                manager.ForEntitiesMatching<SignatureVelocity>([](auto /*entityIndex*/, InputComponent& inputComponent, CircleComponent&)
+                {
+                    ++inputComponent.key;
+                });
+                assert(countChanged(seen) == 1000);
+
+                // versions follow the components when slots are swapped
+                seen = manager.AdvanceChangeVersion();
+                manager.GetComponent<InputComponent>(998).key = 0;
+                manager.Kill(0);
+                manager.Kill(1);
+                manager.Refresh();
+                manager.CompactComponents();
+
+                EntityIndex changedIndex{ 0 };
+                manager.ForEntitiesMatching<SignatureVelocity, Changed<InputComponent>>(seen, [&changedIndex](auto entityIndex, InputComponent& inputComponent, CircleComponent&)
+                {
+                    assert(inputComponent.key == 0);
+                    changedIndex = entityIndex;
+                });
+                assert(countChanged(seen) == 1);
+
+                // removed components are skipped
+                manager.DeleteComponent<InputComponent>(changedIndex);
+                assert(countChanged(seen) == 0);
+
+                // a callback which joins an owning group moves the slot it just wrote, the write is kept
+                Manager<GroupSettings> groupManager;
+                groupManager.CreateIndices(10, CircleComponent{ 1.0f });
+                groupManager.Refresh();
+                groupManager.AddGroup<SignatureVelocity>();
+
+                seen = groupManager.AdvanceChangeVersion();
+                groupManager.GetComponent<CircleComponent>(5).radius = 2.0f;
+                const auto joined{ groupManager.AdvanceChangeVersion() };
+
+                groupManager.ForEntitiesMatching<SignatureCircle, Changed<CircleComponent>>(seen, [&groupManager](auto entityIndex, CircleComponent& circleComponent)
+                {
+                    circleComponent.radius = 42.0f;
+                    groupManager.AddComponent<InputComponent>(entityIndex);
+                });
+
+                auto written{ 0u };
+                groupManager.ForEntitiesMatching<SignatureCircle, Changed<CircleComponent>>(joined, [&written](auto entityIndex, CircleComponent& circleComponent)
+                {
+                    assert(entityIndex == 5 && circleComponent.radius == 42.0f);
+                    ++written;
+                });
+                assert(written == 1);
+            }
+
+            void RunTimeTestsConcurrentReads()
+            {
+                Manager<ChangeSettings> manager;
+                manager.CreateIndices(5000, CircleComponent{ 1.0f }, InputComponent{ 2 });
+                manager.Refresh();
+
+                const auto countChanged = [&manager](const ChangeVersion sinceVersion)
+                {
+                    auto changed{ 0u };
+                    manager.ForEntitiesMatching<SignatureVelocity, Changed<InputComponent>>(sinceVersion, [&changed](auto /*entityIndex*/, InputComponent&, CircleComponent&)
+                    {
+                        ++changed;
+                    });
+
+                    return changed;
+                };
+
+                // kill predicates run on an executor thread and do not mark their inputs as written
+                auto seen{ manager.AdvanceChangeVersion() };
+                const auto killed
+                {
+                    manager.KillMatching<SignatureVelocity>
+                    (
+                        [](auto entityIndex, InputComponent& inputComponent, CircleComponent&)
+                        {
+                            return entityIndex % 5 == 0 && inputComponent.key == 2;
+                        },
+                        FourThreadExecutor{}
+                    )
+                };
+                assert(killed == 1000);
+                assert(countChanged(seen) == 0);
+
+                manager.Refresh();
+
+                // creating and reading the view marks nothing, its elements are read by four threads
+                const auto view{ manager.View<SignatureVelocity>() };
+                assert(countChanged(seen) == 0);
+
+                std::vector<int> sums(4, 0);
+                std::vector<std::thread> threads;
+
+                for (std::size_t t{ 0 }; t < sums.size(); ++t)
+                {
+                    threads.emplace_back([&view, &sums, t]()
+                    {
+                        const auto share{ view.size() / 4 };
+
+                        for (auto i{ t * share }; i < (t + 1) * share; ++i)
+                        {
+                            sums[t] += std::get<1>(view[i]).key;
+                        }
+                    });
+                }
+
+                for (auto& thread : threads)
+                {
+                    thread.join();
+                }
+
+                for (const auto sum : sums)
+                {
+                    assert(sum == 1000 * 2);
+                }
+
+                // writes through the view are marked afterwards
+                view.MarkWritten();
+                assert(countChanged(seen) == 4000);
+            }
+
+            void RunTimeTestsPopulation()
+            {
+                for (const auto refreshMode : { RefreshMode::SwapCompact, RefreshMode::FreeList })
+                {
+                    MyManager manager;
+                    manager.SetRefreshMode(refreshMode);
+                    manager.CreateIndices(5000, CircleComponent{ 1.0f });
+                    const auto first{ manager.CreateIndices(40, CircleComponent{ 1.0f }, InputComponent{ 1 }) };
+                    manager.CreateIndices(10, InputComponent{ 1 });
+                    manager.Refresh();
+
+                    assert(manager.GetPopulation<CircleComponent>() == 5040);
+                    assert(manager.GetPopulation<InputComponent>() == 50);
+                    assert(manager.GetPopulation<HealthComponent>() == 0);
+
+                    const auto countVelocity = [&manager]()
+                    {
+                        auto visited{ 0u };
+                        manager.ForEntitiesMatching<SignatureVelocity>([&visited](auto /*entityIndex*/, InputComponent&, CircleComponent&)
+                        {
+                            ++visited;
+                        });
+
+                        return visited;
+                    };
+
+                    // the rare input component drives the scan
+                    const auto stats{ manager.PlanQuery<SignatureVelocity>() };
+                    assert(stats.usedPopulation);
+                    assert(stats.drivingComponentId == MySettings::GetComponentId<InputComponent>());
+                    assert(stats.candidateCount == 50);
+                    assert(countVelocity() == 40);
+
+                    // kills leave the population at once; both ways skip them before the next refresh
+                    manager.Kill(first);
+                    manager.DeleteComponent<InputComponent>(first + 1);
+                    assert(manager.PlanQuery<SignatureVelocity>().usedPopulation);
+                    assert(countVelocity() == 38);
+
+                    manager.SetPrefetchDistance(4);
+                    assert(countVelocity() == 38);
+                    manager.SetPrefetchDistance(0);
+
+                    manager.Refresh();
+                    assert(manager.GetPopulation<InputComponent>() == 48);
+                    assert(countVelocity() == 38);
+                    assert(manager.PlanQuery<SignatureVelocity>().candidateCount == 48);
+
+                    // common components are scanned as before
+                    assert(manager.PlanQuery<SignatureLife>().usedPopulation);
+                    assert(manager.PlanQuery<SignatureLife>().candidateCount == 0);
+
+                    manager.ForEntities([&manager](auto entityIndex)
+                    {
+                        manager.AddComponent<InputComponent>(entityIndex);
+                    });
+                    assert(manager.GetPopulation<InputComponent>() == manager.GetEntityCount());
+                    assert(!manager.PlanQuery<SignatureVelocity>().usedPopulation);
+                    assert(countVelocity() == 5039);
+
+                    manager.Kill(first + 2);
+                    assert(countVelocity() == 5038);
+
+                    for (const auto scanMode : { ScanMode::PerEntity, ScanMode::Blocks })
+                    {
+                        manager.SetScanMode(scanMode);
+                        assert(countVelocity() == 5038);
+                    }
+
+                    manager.SetScanMode(ScanMode::PerEntity);
+                }
+
+                // every callback removes the input of the next match and kills the one after it,
+                // every way of finding the matches must skip both as a loop over single entities does
+                for (const auto inputCount : { 40u, 5040u })
+                {
+                    for (const auto scanMode : { ScanMode::PerEntity, ScanMode::Blocks })
+                    {
+                        for (const auto prefetchDistance : { 0u, 4u })
+                        {
+                            MyManager manager;
+                            manager.CreateIndices(5040 - inputCount, CircleComponent{ 1.0f });
+                            manager.CreateIndices(inputCount, CircleComponent{ 1.0f }, InputComponent{ 1 });
+                            manager.Refresh();
+                            manager.SetScanMode(scanMode);
+                            manager.SetPrefetchDistance(prefetchDistance);
+                            assert(manager.PlanQuery<SignatureVelocity>().usedPopulation == (inputCount == 40));
+
+                            auto visited{ 0u };
+                            manager.ForEntitiesMatching<SignatureVelocity>([&manager, &visited](auto entityIndex, InputComponent&, CircleComponent&)
+                            {
+                                assert(manager.IsAlive(entityIndex) && manager.HasComponent<InputComponent>(entityIndex));
+                                ++visited;
+
+                                if (entityIndex + 2 < manager.GetEntityCount())
+                                {
+                                    manager.DeleteComponent<InputComponent>(entityIndex + 1);
+                                    manager.Kill(entityIndex + 2);
+                                }
+                            });
+
+                            assert(visited == (inputCount + 2) / 3);
+                        }
+                    }
+                }
+            }
+
+            void RunTimeTestsFused()
+            {
+                MyManager manager;
+                manager.CreateIndices(1500, CircleComponent{ 1.0f }, InputComponent{ 1 });
+                manager.CreateIndices(1000, HealthComponent{ 10 });
+                manager.CreateIndices(500, CircleComponent{ 1.0f }, InputComponent{ 1 }, HealthComponent{ 10 });
+                manager.Kill(3);
+                manager.Refresh();
+
+                std::vector<std::pair<EntityIndex, int>> calls;
+
+                manager.ForEntitiesMatchingFused<SignatureVelocity, SignatureLife, SignatureVelocity>
+                (
+                    [&calls](auto entityIndex, InputComponent& inputComponent, CircleComponent& circleComponent)
+                    {
+                        circleComponent.radius += static_cast<float>(inputComponent.key);
+                        calls.emplace_back(entityIndex, 0);
+                    },
+                    [&calls](auto entityIndex, HealthComponent& healthComponent)
+                    {
+                        --healthComponent.health;
+                        calls.emplace_back(entityIndex, 1);
+                    },
+                    [&calls](auto entityIndex, InputComponent&, CircleComponent& circleComponent)
+                    {
+                        // runs after the first callable for the same entity
+                        assert(circleComponent.radius == 2.0f);
+                        calls.emplace_back(entityIndex, 2);
+                    }
+                );
+
+                // one visit per entity and signature, ordered by entity and then by callable
+                assert(calls.size() == 1999 * 2 + 1500);
+                assert(std::is_sorted(calls.cbegin(), calls.cend()));
+                assert(std::adjacent_find(calls.cbegin(), calls.cend()) == calls.cend());
+
+                manager.ForEntitiesMatching<SignatureLife>([](auto /*entityIndex*/, HealthComponent& healthComponent)
+                {
+                    assert(healthComponent.health == 9);
+                });
+            }
+
+            void RunTimeTestsGatherScatter()
+            {
+                MyManager manager;
+                manager.CreateIndices(100, CircleComponent{ 1.0f }, InputComponent{ 1 });
+                manager.CreateIndices(50, HealthComponent{});
+                manager.CreateIndices(100, CircleComponent{ 2.0f }, InputComponent{ 2 });
+                manager.Refresh();
+
+                assert(manager.GetMatchCount<SignatureVelocity>() == 200);
+
+                std::vector<float> radii(manager.GetMatchCount<SignatureVelocity>());
+                assert(manager.Gather<SignatureVelocity>(&CircleComponent::radius, Span<float>(radii)) == 200);
+                assert(radii[0] == 1.0f && radii[199] == 2.0f);
+
+                for (auto& radius : radii)
+                {
+                    radius *= 10.0f;
+                }
+
+                assert(manager.Scatter<SignatureVelocity>(&CircleComponent::radius, Span<const float>(radii)) == 200);
+                assert(manager.GetComponent<CircleComponent>(0).radius == 10.0f);
+                assert(manager.GetComponent<CircleComponent>(249).radius == 20.0f);
+
+                // the cached match list follows structural changes
+                manager.Kill(0);
+                manager.DeleteComponent<InputComponent>(249);
+                manager.Refresh();
+                manager.CompactComponents();
+                assert(manager.GetMatchCount<SignatureVelocity>() == 198);
+
+                std::vector<InputComponent> inputs(198);
+                assert((manager.Gather<SignatureVelocity, InputComponent>(inputs)) == 198);
+
+                auto sum{ 0 };
+                for (auto& inputComponent : inputs)
+                {
+                    sum += inputComponent.key;
+                    inputComponent.key = 7;
+                }
+                assert(sum == 99 * 1 + 99 * 2);
+
+                manager.Scatter<SignatureVelocity, InputComponent>(inputs);
+                manager.ForEntitiesMatching<SignatureVelocity>([](auto /*entityIndex*/, InputComponent& inputComponent, CircleComponent&)
+                {
+                    assert(inputComponent.key == 7);
+                });
+
+                // a refresh without created or killed entities keeps the cached match list
+                const auto structureVersion{ manager.GetStructureVersion() };
+                manager.Refresh();
+                assert(manager.GetStructureVersion() == structureVersion);
+
+                manager.CreateIndex();
+                manager.Refresh();
+                assert(manager.GetStructureVersion() != structureVersion);
+            }
+
+            struct ChildOf {};
+            struct Likes {};
+
+            using RelationSettings = Settings<MyComponentsList, MySignaturesList, RelationList<ChildOf, Likes>>;
+
+            /**
+             * @brief Compares the relation indexes with a reference set of pairs, keyed by the `InputComponent::key` of each entity.
+             */
+            void CheckRelations(Manager<RelationSettings>& manager, const std::set<std::pair<int, int>>& pairs)
+            {
+                std::map<int, EntityIndex> entityByKey;
+                manager.ForEntities([&manager, &entityByKey](auto entityIndex)
+                {
+                    entityByKey[manager.GetComponent<InputComponent>(entityIndex).key] = entityIndex;
+                });
+
+                std::size_t targetCount{ 0 };
+                std::size_t sourceCount{ 0 };
+
+                for (const auto& entry : entityByKey)
+                {
+                    for (const auto target : manager.GetRelationTargets<ChildOf>(entry.second))
+                    {
+                        assert(pairs.count({ entry.first, manager.GetComponent<InputComponent>(target).key }) == 1);
+                        ++targetCount;
+                    }
+
+                    for (const auto source : manager.GetRelationSources<ChildOf>(entry.second))
+                    {
+                        assert(pairs.count({ manager.GetComponent<InputComponent>(source).key, entry.first }) == 1);
+                        ++sourceCount;
+                    }
+                }
+
+                for (const auto& pair : pairs)
+                {
+                    assert(manager.HasRelation<ChildOf>(entityByKey.at(pair.first), entityByKey.at(pair.second)));
+                }
+
+                assert(targetCount == pairs.size());
+                assert(sourceCount == pairs.size());
+            }
+
+            void RunTimeTestsRelations()
+            {
+                static_assert(RelationSettings::RelationCount() == 2, "");
+                static_assert(RelationSettings::GetRelationId<Likes>() == 1, "");
+                static_assert(MySettings::RelationCount() == 0, "");
+
+                {
+                    Manager<RelationSettings> manager;
+                    const auto parent{ manager.CreateIndex() };
+                    const auto child0{ manager.CreateIndex() };
+                    const auto child1{ manager.CreateIndex() };
+
+                    manager.AddRelation<ChildOf>(child0, parent);
+                    manager.AddRelation<ChildOf>(child1, parent);
+                    manager.AddRelation<ChildOf>(child1, parent);
+                    manager.AddRelation<Likes>(parent, child0);
+
+                    assert(manager.GetRelationSources<ChildOf>(parent).size() == 2);
+                    assert(manager.GetRelationTargets<ChildOf>(child1).size() == 1);
+                    assert(manager.HasRelation<Likes>(parent, child0));
+                    assert(!manager.HasRelation<Likes>(child0, parent));
+
+                    manager.RemoveRelation<ChildOf>(child1, parent);
+                    assert(manager.GetRelationSources<ChildOf>(parent).size() == 1);
+                    assert(manager.GetRelationSources<ChildOf>(parent)[0] == child0);
+
+                    // killing the parent drops both directions of all its pairs
+                    manager.Kill(parent);
+                    assert(manager.GetRelationTargets<ChildOf>(child0).size() == 0);
+                    assert(manager.GetRelationSources<Likes>(child0).size() == 0);
+
+                    manager.Clear();
+                    assert(manager.GetRelationSources<ChildOf>(parent).size() == 0);
+                }
+
+                // the indexes follow the entities through every refresh mode, kills and sorting
+                for (const auto refreshMode : { RefreshMode::SwapCompact, RefreshMode::StableCompact, RefreshMode::FreeList })
+                {
+                    Manager<RelationSettings> manager;
+                    manager.SetRefreshMode(refreshMode);
+
+                    std::mt19937 random{ 7 };
+                    std::set<std::pair<int, int>> pairs;
+                    auto nextKey{ 0 };
+
+                    for (auto round{ 0 }; round < 20; ++round)
+                    {
+                        for (auto i{ 0 }; i < 30; ++i)
+                        {
+                            manager.AddComponent<InputComponent>(manager.CreateIndex()).key = nextKey++;
+                        }
+
+                        manager.Refresh();
+
+                        std::vector<EntityIndex> alive;
+                        manager.ForEntities([&alive](auto entityIndex)
+                        {
+                            alive.push_back(entityIndex);
+                        });
+
+                        for (auto i{ 0 }; i < 60; ++i)
+                        {
+                            const auto source{ alive[random() % alive.size()] };
+                            const auto target{ alive[random() % alive.size()] };
+                            manager.AddRelation<ChildOf>(source, target);
+                            pairs.insert({ manager.GetComponent<InputComponent>(source).key, manager.GetComponent<InputComponent>(target).key });
+                        }
+
+                        for (auto i{ 0 }; i < 15; ++i)
+                        {
+                            const auto victim{ alive[random() % alive.size()] };
+                            if (!manager.IsAlive(victim))
+                            {
+                                continue;
+                            }
+
+                            const auto key{ manager.GetComponent<InputComponent>(victim).key };
+                            for (auto it{ pairs.begin() }; it != pairs.end();)
+                            {
+                                it = it->first == key || it->second == key ? pairs.erase(it) : std::next(it);
+                            }
+
+                            manager.Kill(victim);
+                        }
+
+                        manager.Refresh();
+                        CheckRelations(manager, pairs);
+
+                        if (round % 5 == 4)
+                        {
+                            manager.SortBy<InputComponent>([](const InputComponent& lhs, const InputComponent& rhs) { return lhs.key > rhs.key; });
+                            CheckRelations(manager, pairs);
+                        }
+                    }
+                }
+            }
+
+            void RunTimeTestsHierarchy()
+            {
+                static constexpr std::size_t COUNT{ 500 };
+
+                Manager<RelationSettings> manager;
+                manager.SetRefreshMode(RefreshMode::StableCompact);
+
+                // every node has a random parent with a smaller key, the nodes are created in shuffled order
+                std::mt19937 random{ 3 };
+                std::vector<int> keys(COUNT);
+                std::vector<int> parentKeys(COUNT, -1);
+                for (auto key{ 0u }; key < COUNT; ++key)
+                {
+                    keys[key] = key;
+                    parentKeys[key] = key < 5 ? -1 : static_cast<int>(random() % key);
+                }
+
+                std::shuffle(keys.begin(), keys.end(), random);
+
+                std::vector<EntityIndex> entityByKey(COUNT);
+                for (const auto key : keys)
+                {
+                    entityByKey[key] = manager.CreateIndex();
+                    manager.AddComponent<InputComponent>(entityByKey[key]).key = key;
+                    manager.AddComponent<CircleComponent>(entityByKey[key]).radius = static_cast<float>(key % 7);
+                }
+
+                for (auto key{ 0u }; key < COUNT; ++key)
+                {
+                    if (parentKeys[key] >= 0)
+                    {
+                        manager.AddRelation<ChildOf>(entityByKey[key], entityByKey[parentKeys[key]]);
+                    }
+                }
+
+                // the expected world values
+                std::vector<float> expected(COUNT, 0.0f);
+                for (auto key{ 0u }; key < COUNT; ++key)
+                {
+                    expected[key] = static_cast<float>(key % 7) + (parentKeys[key] >= 0 ? expected[parentKeys[key]] : 0.0f);
+                }
+
+                const auto propagate = [&manager, &expected]()
+                {
+                    std::vector<float> world(manager.GetEntityCount(), -1.0f);
+                    manager.ForEntitiesMatching<SignatureVelocity>([&manager, &world](auto entityIndex, InputComponent&, CircleComponent& circleComponent)
+                    {
+                        const auto parents{ manager.GetRelationTargets<ChildOf>(entityIndex) };
+                        auto parentWorld{ 0.0f };
+
+                        if (!parents.empty())
+                        {
+                            // the parent has been visited already
+                            assert(world[parents[0]] >= 0.0f);
+                            parentWorld = world[parents[0]];
+                        }
+
+                        world[entityIndex] = circleComponent.radius + parentWorld;
+                    });
+
+                    manager.ForEntities([&manager, &world, &expected](auto entityIndex)
+                    {
+                        assert(world[entityIndex] == expected[manager.GetComponent<InputComponent>(entityIndex).key]);
+                    });
+                };
+
+                assert(manager.SortHierarchy<ChildOf>());
+                assert(!manager.SortHierarchy<ChildOf>());
+                propagate();
+
+                // the depths do not decrease along the storage
+                std::vector<std::size_t> depths(manager.GetEntityCount(), 0);
+                manager.ForEntities([&manager, &depths](auto entityIndex)
+                {
+                    const auto parents{ manager.GetRelationTargets<ChildOf>(entityIndex) };
+                    depths[entityIndex] = parents.empty() ? 0 : depths[parents[0]] + 1;
+                    assert(entityIndex == 0 || depths[entityIndex - 1] <= depths[entityIndex]);
+                });
+
+                // stable compaction keeps the order, but moves the components of the entities behind a kill
+                auto leaf{ static_cast<EntityIndex>(COUNT / 2) };
+                while (!manager.GetRelationSources<ChildOf>(leaf).empty())
+                {
+                    ++leaf;
+                }
+
+                manager.Kill(leaf);
+                manager.Refresh();
+                assert(manager.GetFragmentation() > 0.0f);
+                assert(!manager.SortHierarchy<ChildOf>());
+                assert(manager.GetFragmentation() == 0.0f);
+
+                // a new child of a root is appended behind deeper entities, which breaks the depth order
+                const auto child{ manager.CreateIndex() };
+                manager.AddComponent<InputComponent>(child).key = 0;
+                manager.AddRelation<ChildOf>(child, 0);
+                manager.Refresh();
+                assert(manager.SortHierarchy<ChildOf>());
+                assert(!manager.SortHierarchy<ChildOf>());
+
+                // a new root above an existing root breaks the order
+                const auto root{ manager.CreateIndex() };
+                manager.Refresh();
+                manager.AddRelation<ChildOf>(0, root);
+                assert(manager.SortHierarchy<ChildOf>());
+
+                manager.ForEntities([&manager](auto entityIndex)
+                {
+                    const auto parents{ manager.GetRelationTargets<ChildOf>(entityIndex) };
+                    assert(parents.empty() || parents[0] < entityIndex);
+                });
+
+                // a cycle is rejected and nothing is moved
+                const auto first{ manager.CreateIndex() };
+                const auto second{ manager.CreateIndex() };
+                manager.AddComponent<InputComponent>(first).key = 1;
+                manager.AddComponent<InputComponent>(second).key = 2;
+                manager.Refresh();
+                manager.AddRelation<ChildOf>(first, second);
+                manager.AddRelation<ChildOf>(second, first);
+
+                auto rejected{ false };
+                try
+                {
+                    manager.SortHierarchy<ChildOf>();
+                }
+                catch (const std::invalid_argument&)
+                {
+                    rejected = true;
+                }
+
+                assert(rejected);
+                assert(manager.GetComponent<InputComponent>(first).key == 1);
+                assert(manager.GetComponent<InputComponent>(second).key == 2);
+
+                // owning groups keep their slots, sorting is rejected
+                Manager<RelationSettings> groupManager;
+                groupManager.CreateIndices(3, InputComponent{}, CircleComponent{});
+                groupManager.Refresh();
+                groupManager.AddGroup<SignatureVelocity>();
+                groupManager.AddRelation<ChildOf>(0, 2);
+
+                rejected = false;
+                try
+                {
+                    groupManager.SortHierarchy<ChildOf>();
+                }
+                catch (const std::invalid_argument&)
+                {
+                    rejected = true;
+                }
+
+                assert(rejected);
+            }
+
+            struct PointComponent
+            {
+                float x{ 0 };
+                float y{ 0 };
+            };
+
+            using SignaturePoint = Signature<PointComponent, HealthComponent>;
+            using SpatialSettings = Settings<ComponentList<PointComponent, HealthComponent>, SignatureList<SignaturePoint>>;
+
+            /**
+             * @brief Compares radius and box queries of a grid with a scan over all entities.
+             */
+            void CheckSpatialGrid(Manager<SpatialSettings>& manager, const SpatialGrid<SpatialSettings, PointComponent>& grid, std::mt19937& random)
+            {
+                std::vector<EntityIndex> result;
+                std::vector<EntityIndex> expected;
+
+                for (auto query{ 0 }; query < 50; ++query)
+                {
+                    const auto x{ static_cast<float>(random() % 200) - 100.0f };
+                    const auto y{ static_cast<float>(random() % 200) - 100.0f };
+                    const auto radius{ static_cast<float>(random() % 40) };
+
+                    grid.QueryRadius(x, y, radius, result);
+                    expected.clear();
+                    manager.ForEntities([&](auto entityIndex)
+                    {
+                        if (!manager.HasComponent<PointComponent>(entityIndex))
+                        {
+                            return;
+                        }
+
+                        const auto& point{ static_cast<const Manager<SpatialSettings>&>(manager).GetComponent<PointComponent>(entityIndex) };
+                        if ((point.x - x) * (point.x - x) + (point.y - y) * (point.y - y) <= radius * radius)
+                        {
+                            expected.push_back(entityIndex);
+                        }
+                    });
+
+                    std::sort(result.begin(), result.end());
+                    assert(result == expected);
+
+                    grid.QueryBox(x, y, x + radius, y + radius * 0.5f, result);
+                    expected.clear();
+                    manager.ForEntities([&](auto entityIndex)
+                    {
+                        if (!manager.HasComponent<PointComponent>(entityIndex))
+                        {
+                            return;
+                        }
+
+                        const auto& point{ static_cast<const Manager<SpatialSettings>&>(manager).GetComponent<PointComponent>(entityIndex) };
+                        if (point.x >= x && point.x <= x + radius && point.y >= y && point.y <= y + radius * 0.5f)
+                        {
+                            expected.push_back(entityIndex);
+                        }
+                    });
+
+                    std::sort(result.begin(), result.end());
+                    assert(result == expected);
+                }
+
+                assert(grid.GetSize() == manager.GetPopulation<PointComponent>());
+            }
+
+            void RunTimeTestsSpatialGrid()
+            {
+                Manager<SpatialSettings> manager;
+                std::mt19937 random{ 11 };
+
+                for (auto i{ 0 }; i < 2000; ++i)
+                {
+                    auto& point{ manager.AddComponent<PointComponent>(manager.CreateIndex()) };
+                    point.x = static_cast<float>(random() % 20000) * 0.01f - 100.0f;
+                    point.y = static_cast<float>(random() % 20000) * 0.01f - 100.0f;
+                }
+                manager.Refresh();
+
+                // few buckets, so that many cells share one and large boxes scan all entries
+                SpatialGrid<SpatialSettings, PointComponent> grid{ 5.0f, 16 };
+                grid.Update(manager);
+                CheckSpatialGrid(manager, grid, random);
+
+                // moving entities without structural changes updates only those
+                const auto structureVersion{ manager.GetStructureVersion() };
+                for (auto i{ 0 }; i < 300; ++i)
+                {
+                    auto& point{ manager.GetComponent<PointComponent>(random() % manager.GetEntityCount()) };
+                    point.x += static_cast<float>(random() % 2000) * 0.01f - 10.0f;
+                    point.y += static_cast<float>(random() % 2000) * 0.01f - 10.0f;
+                }
+                assert(manager.GetStructureVersion() == structureVersion);
+
+                grid.Update(manager);
+                CheckSpatialGrid(manager, grid, random);
+
+                // the change versions of other consumers stay valid
+                const auto sinceVersion{ manager.AdvanceChangeVersion() };
+                manager.GetComponent<PointComponent>(7).x = 1000.0f;
+                grid.Update(manager);
+
+                auto changedCount{ 0 };
+                manager.ForChangedComponents<PointComponent>(sinceVersion, [&changedCount](auto entityIndex, const PointComponent& point)
+                {
+                    assert(entityIndex == 7 && point.x == 1000.0f);
+                    ++changedCount;
+                });
+                assert(changedCount == 1);
+
+                std::vector<EntityIndex> candidates;
+                grid.QueryRadius(1000.0f, manager.GetComponent<PointComponent>(7).y, 0.5f, candidates);
+                assert(candidates.size() == 1 && candidates[0] == 7);
+
+                // the candidates feed the signature iteration
+                manager.AddComponent<HealthComponent>(7).health = 3;
+                grid.Update(manager);
+                grid.QueryRadius(0.0f, 0.0f, 2000.0f, candidates);
+
+                auto matchCount{ 0 };
+                manager.ForEntitiesMatching<SignaturePoint>(candidates, [&matchCount](auto entityIndex, HealthComponent& healthComponent, PointComponent&)
+                {
+                    assert(entityIndex == 7 && healthComponent.health == 3);
+                    ++matchCount;
+                });
+                assert(matchCount == 1);
+
+                // kills and swaps rebuild the grid
+                for (auto i{ 0 }; i < 500; ++i)
+                {
+                    manager.Kill(random() % manager.GetEntityCount());
+                }
+                manager.Refresh();
+
+                grid.Update(manager);
+                CheckSpatialGrid(manager, grid, random);
+
+                // entities without a position, removed positions and moved entity indices update only their own indices
+                const auto spawned{ manager.CreateIndex() };
+                manager.AddComponent<HealthComponent>(spawned).health = 1;
+                manager.DeleteComponent<PointComponent>(3);
+                manager.Kill(5);
+                manager.Refresh();
+
+                grid.Update(manager);
+                CheckSpatialGrid(manager, grid, random);
+
+                // stable compaction slides every entity behind the first kill
+                manager.SetRefreshMode(RefreshMode::StableCompact);
+                for (auto i{ 0 }; i < 50; ++i)
+                {
+                    manager.Kill(random() % manager.GetEntityCount());
+                }
+                manager.Refresh();
+
+                grid.Update(manager);
+                CheckSpatialGrid(manager, grid, random);
+
+                // coordinates beyond the range of cell indices land in the outermost cells
+                manager.GetComponent<PointComponent>(9).x = 1e30f;
+                manager.GetComponent<PointComponent>(10).y = -std::numeric_limits<float>::infinity();
+                manager.GetComponent<PointComponent>(11).x = std::numeric_limits<float>::quiet_NaN();
+                grid.Update(manager);
+
+                grid.QueryRadius(1e30f, manager.GetComponent<PointComponent>(9).y, 1.0f, candidates);
+                assert(candidates.size() == 1 && candidates[0] == 9);
+                grid.QueryBox(-1e30f, -std::numeric_limits<float>::infinity(), 1e30f, -1e30f, candidates);
+                assert(candidates.size() == 1 && candidates[0] == 10);
+                assert(grid.GetSize() == manager.GetPopulation<PointComponent>());
+            }
         }
     }
 }
 
-int main()
+int main(int argc, char* argv[])
 {
+    if (argc > 1 && std::string(argv[1]) == "--bench")
+    {
+        sg::ecs::bench::RunBenchmarks();
+        return 0;
+    }
+
     sg::ecs::test::RuntimeTests();
     sg::ecs::test::RunTimeTestsSignatures();
+    sg::ecs::test::RunTimeTestsFreeList();
+    sg::ecs::test::RunTimeTestsRefresh();
+    sg::ecs::test::RunTimeTestsCreateIndices();
+    sg::ecs::test::RunTimeTestsKillMatching();
+    sg::ecs::test::RunTimeTestsCompactComponents();
+    sg::ecs::test::RunTimeTestsStableRefresh();
+    sg::ecs::test::RunTimeTestsPrefab();
+    sg::ecs::test::RunTimeTestsClone();
+    sg::ecs::test::RunTimeTestsMoveEntities();
+    sg::ecs::test::RunTimeTestsCommandBuffers();
+    sg::ecs::test::RunTimeTestsMatchBlocks();
+    sg::ecs::test::RunTimeTestsSignatureTerms();
+    sg::ecs::test::RunTimeTestsView();
+    sg::ecs::test::RunTimeTestsForEachChunk();
+    sg::ecs::test::RunTimeTestsPrefetch();
+    sg::ecs::test::RunTimeTestsQuery();
+    sg::ecs::test::RunTimeTestsGroups();
+    sg::ecs::test::RunTimeTestsSortBy();
+    sg::ecs::test::RunTimeTestsChangeVersions();
+    sg::ecs::test::RunTimeTestsConcurrentReads();
+    sg::ecs::test::RunTimeTestsPopulation();
+    sg::ecs::test::RunTimeTestsFused();
+    sg::ecs::test::RunTimeTestsGatherScatter();
+    sg::ecs::test::RunTimeTestsRelations();
+    sg::ecs::test::RunTimeTestsHierarchy();
+    sg::ecs::test::RunTimeTestsSpatialGrid();
     std::cout << "Tests passed!" << std::endl;
 
     return 0;
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstddef>
 #include <tuple>
+#include <type_traits>
 #include <boost/mpl/fold.hpp>
 
 namespace sg
@@ -85,5 +87,70 @@ namespace sg
                 AddTo<boost::mpl::_1, boost::mpl::_2>
             >::type;
         };
+
+        //-------------------------------------------------
+        // Decay the element types of a tuple
+        //-------------------------------------------------
+
+        // Job: The value type of a tuple of references, e.g. for proxy iterators.
+        // Call: DecayTuple<std::tuple<int&, const float&>>::type is std::tuple<int, float>
+
+        template <typename TTuple>
+        struct DecayTuple;
+
+        template <typename... Ts>
+        struct DecayTuple<std::tuple<Ts...>>
+        {
+            using type = std::tuple<std::decay_t<Ts>...>;
+        };
+
+        //-------------------------------------------------
+        // Span
+        //-------------------------------------------------
+
+        // Job: A non-owning view over contiguous elements, like the C++20 `std::span`.
+        // Call: Span<const EntityIndex> indices{ myVector };
+
+        template <typename T>
+        class Span
+        {
+        public:
+            using element_type = T;
+            using value_type = std::remove_cv_t<T>;
+            using iterator = T*;
+
+            constexpr Span() noexcept = default;
+
+            constexpr Span(T* data, const std::size_t size) noexcept
+                : m_data{ data }
+                , m_size{ size }
+            {}
+
+            template <
+                typename TContainer,
+                typename = std::enable_if_t<std::is_convertible<decltype(std::declval<TContainer&>().data()), T*>::value>
+            >
+            constexpr Span(TContainer& container) noexcept
+                : m_data{ container.data() }
+                , m_size{ container.size() }
+            {}
+
+            template <std::size_t N>
+            constexpr Span(T(&array)[N]) noexcept
+                : m_data{ array }
+                , m_size{ N }
+            {}
+
+            constexpr T* data() const noexcept { return m_data; }
+            constexpr std::size_t size() const noexcept { return m_size; }
+            constexpr bool empty() const noexcept { return m_size == 0; }
+            constexpr T& operator[](const std::size_t index) const noexcept { return m_data[index]; }
+            constexpr iterator begin() const noexcept { return m_data; }
+            constexpr iterator end() const noexcept { return m_data + m_size; }
+
+        private:
+            T* m_data{ nullptr };
+            std::size_t m_size{ 0 };
+        };
     }
 }